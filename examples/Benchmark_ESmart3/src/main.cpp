@@ -0,0 +1,411 @@
+/*
+Benchmark of the Joba_ESmart3 hot paths
+
+Measures time per operation of frame encode/decode (with crc, offsets and dwSwap),
+field access, the monitor serializers (json, influx line, mqtt field payloads, shared with
+Monitor_ESmart3 through its esmart3_format.h) and the per sample work of the ESmart3Energy,
+ESmart3Soc, ESmart3Stats and ESmart3Events helpers.
+No eSmart3 is needed: a simulated device answers all frames from RAM without any uart,
+so bus transactions measure only cpu work. The simulator alone is measured as well ("sim GET ChgSts")
+and can be subtracted from the transaction results.
+
+On ESP32/ESP8266 each benchmark is run RUNS times counting cpu cycles, the fastest run counts
+(least disturbed by interrupts). Results are printed every BENCH_INTERVAL_MS to Serial.
+On a Linux host (make -C linux bench) it prints a Google Benchmark like table once: iterations
+grow until a run takes at least BENCH_MIN_TIME_NS, then wall and cpu time per operation are reported.
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+#include <esmart3.h>
+#include <esmart3_energy.h>
+#include <esmart3_events.h>
+#include <esmart3_soc.h>
+#include <esmart3_stats.h>
+
+#include "../../Monitor_ESmart3/src/esmart3_format.h"  // the serializers measured
+
+#define RUNS 5
+#define BENCH_INTERVAL_MS 30000
+#define BENCH_MIN_TIME_NS 200000000ull
+
+
+// Simulated eSmart3: answers GET and SET frames from item memory
+class SimStream : public Stream {
+public:
+    SimStream() : _in_len(0), _out_len(0), _out_pos(0) { memset(_mem, 0, sizeof(_mem)); }
+
+    // Item memory, indexed by word offset
+    uint8_t *mem( ESmart3::item_t item ) { return _mem[item]; }
+
+    size_t write( uint8_t c ) override {
+        if( _in_len < sizeof(_in) ) {
+            _in[_in_len++] = c;
+        }
+        if( _in_len >= sizeof(ESmart3::header_t) && _in[5] > FRAME_SIZE - sizeof(ESmart3::header_t) - 1 ) {
+            _in_len = 0;  // can't be a frame, resync
+        }
+        else if( _in_len >= sizeof(ESmart3::header_t) && _in_len == sizeof(ESmart3::header_t) + _in[5] + 1 ) {
+            process();
+            _in_len = 0;
+        }
+        return 1;
+    }
+
+    using Print::write;  // buffer variant calls write(uint8_t) for each byte
+
+    int available() override { return _out_len - _out_pos; }
+    int read() override { return _out_pos < _out_len ? _out[_out_pos++] : -1; }
+    int peek() override { return _out_pos < _out_len ? _out[_out_pos] : -1; }
+
+private:
+    enum { ITEMS = ESmart3::EngSave + 1, ITEM_SIZE = 400, FRAME_SIZE = 6 + 120 + 1 };
+
+    void process() {
+        uint8_t item = _in[4];
+        uint8_t offset = _in[6];
+        if( item >= ITEMS ) {
+            reply(ESmart3::NACK, item, 0, 0);
+        }
+        else if( _in[3] == ESmart3::GET && _in[5] == 3 && _in[8] <= ESmart3::MAX_RESULT
+          && offset * 2u + _in[8] <= ITEM_SIZE ) {
+            reply(ESmart3::ACK, item, &_mem[item][offset * 2], _in[8]);
+        }
+        else if( _in[3] == ESmart3::SET && _in[5] >= 2 && offset * 2u + _in[5] - 2 <= ITEM_SIZE ) {
+            memcpy(&_mem[item][offset * 2], &_in[8], _in[5] - 2);
+            reply(ESmart3::ACK, item, 0, 0);
+        }
+        else {
+            reply(ESmart3::NACK, item, 0, 0);
+        }
+    }
+
+    void reply( uint8_t command, uint8_t item, const uint8_t *data, uint8_t len ) {
+        uint8_t crc = 0;
+        _out_len = 0;
+        _out_pos = 0;
+        _out[_out_len++] = 0xaa;
+        _out[_out_len++] = ESmart3::MPPT;
+        _out[_out_len++] = ESmart3::BROADCAST;
+        _out[_out_len++] = command;
+        _out[_out_len++] = item;
+        _out[_out_len++] = data ? len + 2 : 0;
+        if( data ) {
+            _out[_out_len++] = _in[6];
+            _out[_out_len++] = _in[7];
+            memcpy(&_out[_out_len], data, len);
+            _out_len += len;
+        }
+        for( size_t i = 0; i < _out_len; i++ ) {
+            crc -= _out[i];
+        }
+        _out[_out_len++] = crc;
+    }
+
+    uint8_t _mem[ITEMS][ITEM_SIZE];
+    uint8_t _in[FRAME_SIZE];
+    size_t _in_len;
+    uint8_t _out[FRAME_SIZE];
+    size_t _out_len;
+    size_t _out_pos;
+};
+
+
+SimStream sim;
+ESmart3 esmart3(sim, NULL, 0);  // no command delay: measure cpu only
+
+ESmart3Energy energy;
+ESmart3Soc soc;
+ESmart3Stats stats;
+ESmart3Events events;
+
+ESmart3::Information_t information;
+ESmart3::ChgSts_t sample;
+uint32_t sample_ms = 0;  // simulated time of sample, 500ms steps
+
+char out[512];
+volatile uint32_t sink;  // keeps results alive
+
+
+// Next simulated ChgSts sample: small changes like a real device
+void next_sample() {
+    static uint32_t n = 0;
+    n++;
+    sample.wChgMode = ESmart3::CHG_MPPT;
+    sample.wPvVolt = 380 + (n & 15);
+    sample.wBatVolt = 132 + (n & 3);
+    sample.wChgCurr = 50 + (n & 7);
+    sample.wOutVolt = sample.wBatVolt;
+    sample.wLoadVolt = sample.wBatVolt;
+    sample.wLoadCurr = 10 + (n & 1);
+    sample.wChgPower = sample.wBatVolt * sample.wChgCurr / 100;
+    sample.wLoadPower = sample.wBatVolt * sample.wLoadCurr / 100;
+    sample.wBatTemp = 20;
+    sample.wInnerTemp = 30 + (n & 1);
+    sample.wBatCap = 80;
+    sample.dwCO2 = n;
+    sample.wFault = (n & 255) == 0 ? 1 : 0;
+    sample.wSystemReminder = 0;
+    sample_ms += 500;
+}
+
+
+// Benchmarked operations
+
+void b_sim() {
+    // GET ChgSts frame as sent by getChgSts(), answered by simulator and drained
+    static uint8_t frame[] = { 0xaa, ESmart3::MPPT, ESmart3::BROADCAST, ESmart3::GET, ESmart3::ChgSts, 3,
+        0, 0, sizeof(ESmart3::ChgSts_t), 0 };
+    sim.write(frame, sizeof(frame));
+    while( sim.read() >= 0 );
+}
+
+void b_getChgSts() {
+    ESmart3::ChgSts_t data;
+    sink = esmart3.getChgSts(data);
+}
+
+void b_getBatVolt() {
+    ESmart3::ChgSts_t data;
+    sink = esmart3.getChgSts(data, 2, 3);
+}
+
+void b_getLog() {
+    ESmart3::Log_t data;
+    sink = esmart3.getLog(data);
+}
+
+void b_getEngSave() {
+    static ESmart3::EngSave_t data;  // 3 frames
+    sink = esmart3.getEngSave(data);
+}
+
+void b_setLoad() {
+    sink = esmart3.setLoad(true);
+}
+
+void b_value() {
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    int32_t sum = 0;
+    for( size_t i = 0; i < count; i++ ) {
+        sum += ESmart3::value(&sample, fields[i]);
+    }
+    sink = sum;
+}
+
+void b_json() {
+    next_sample();
+    sink = format_json_ChgSts(out, sizeof(out), (char *)information.wSerial, sample);
+}
+
+void b_line() {
+    next_sample();
+    sink = format_line_ChgSts(out, sizeof(out), (char *)information.wSerial, PROGNAME, sample, "");
+}
+
+void b_fields() {
+    // topic and payload of every ChgSts field like Monitor publish_fields() without deadband
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    char topic[64], payload[16];
+    next_sample();
+    for( size_t i = 0; i < count; i++ ) {
+        int32_t value = ESmart3::value(&sample, fields[i]);
+        snprintf(topic, sizeof(topic), PROGNAME "/ChgSts/%s", fields[i].name);
+        format_field(payload, sizeof(payload), i, fields[i], value);
+        sink = topic[0] + payload[0];
+    }
+}
+
+void b_energy() {
+    next_sample();
+    energy.update(sample, sample_ms);
+}
+
+void b_soc() {
+    next_sample();
+    soc.update(sample, sample_ms);
+}
+
+void b_stats() {
+    next_sample();
+    stats.add(sample, sample_ms / 1000, sample_ms);
+}
+
+void b_events() {
+    next_sample();
+    sink = events.update(sample, sample_ms / 1000);
+}
+
+void b_sample() {
+    next_sample();  // share of the helper benchmarks above
+}
+
+
+typedef struct bench {
+    const char *name;
+    void (*fn)();
+    uint32_t iterations;  // per run, small enough to not overflow the cycle counter. Start value on a host
+} bench_t;
+
+const bench_t benches[] = {
+    { "sim GET ChgSts",      b_sim,        1000 },
+    { "getChgSts",           b_getChgSts,  1000 },
+    { "getChgSts BatVolt",   b_getBatVolt, 1000 },
+    { "getLog",              b_getLog,     1000 },
+    { "getEngSave",          b_getEngSave,  200 },
+    { "setLoad",             b_setLoad,    1000 },
+    { "value ChgSts fields", b_value,     10000 },
+    { "json ChgSts",         b_json,       1000 },
+    { "line ChgSts",         b_line,       1000 },
+    { "mqtt ChgSts fields",  b_fields,      200 },
+    { "next_sample",         b_sample,    10000 },
+    { "Energy update",       b_energy,    10000 },
+    { "Soc update",          b_soc,       10000 },
+    { "Stats add",           b_stats,     10000 },
+    { "Events update",       b_events,    10000 },
+};
+
+
+// Device content for the transactions
+void init_device() {
+    memcpy(information.wSerial, "BENCH000", sizeof(information.wSerial));
+    memcpy(sim.mem(ESmart3::Information), &information, sizeof(information));
+    next_sample();
+    memcpy(sim.mem(ESmart3::ChgSts), &sample, sizeof(sample));
+}
+
+
+#if defined(ESP32) || defined(ESP8266)
+
+// Run benchmark RUNS times and print cycles and ns per operation of the fastest run
+void bench( const bench_t &b ) {
+    uint32_t best = UINT32_MAX;
+
+    for( size_t run = 0; run < RUNS; run++ ) {
+        uint32_t start = ESP.getCycleCount();
+        for( uint32_t i = 0; i < b.iterations; i++ ) {
+            b.fn();
+        }
+        uint32_t cycles = ESP.getCycleCount() - start;
+        if( cycles < best ) {
+            best = cycles;
+        }
+        yield();
+    }
+
+    uint32_t per_op = best / b.iterations;
+    Serial.printf("%-20s %8u %10u %10u\n", b.name, b.iterations, per_op, per_op * 1000 / ESP.getCpuFreqMHz());
+}
+
+
+void setup() {
+    Serial.begin(115200);
+    Serial.println("\nStart " PROGNAME " " VERSION);
+    init_device();
+}
+
+
+void loop() {
+    static uint32_t prev = 0;
+    static bool first = true;
+
+    uint32_t now = millis();
+    if( first || now - prev >= BENCH_INTERVAL_MS ) {
+        first = false;
+        prev = now;
+        Serial.printf("\n%s at %u MHz\n", PROGNAME " " VERSION, ESP.getCpuFreqMHz());
+        Serial.printf("%-20s %8s %10s %10s\n", "benchmark", "ops", "cycles/op", "ns/op");
+        for( size_t i = 0; i < sizeof(benches) / sizeof(*benches); i++ ) {
+            bench(benches[i]);
+        }
+    }
+    delay(100);
+}
+
+#else  // Linux host
+
+#include <regex.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t now_ns( clockid_t clock ) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Grow iterations until a run takes at least min_ns and print wall and cpu ns per operation of that run
+void bench( const bench_t &b, uint64_t min_ns ) {
+    uint64_t iterations = b.iterations;
+
+    for(;;) {
+        uint64_t wall = now_ns(CLOCK_MONOTONIC);
+        uint64_t cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+        for( uint64_t i = 0; i < iterations; i++ ) {
+            b.fn();
+        }
+        wall = now_ns(CLOCK_MONOTONIC) - wall;
+        cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+        if( wall >= min_ns ) {
+            printf("%-24s %10.1f ns %10.1f ns %12llu\n", b.name, (double)wall / iterations,
+                (double)cpu / iterations, (unsigned long long)iterations);
+            return;
+        }
+        // aim at 1.4 times the minimum, but grow at most 10 times per step
+        double scale = wall ? 1.4 * min_ns / wall : 10;
+        iterations = (uint64_t)(iterations * (scale < 10 ? scale : 10)) + 1;
+    }
+}
+
+
+void usage( const char *prog ) {
+    fprintf(stderr, "Usage: %s [-f regex] [-t min_ms]\n"
+        "    -f  run only benchmarks with names matching the extended regex\n"
+        "    -t  minimum time per benchmark in ms (default %llu)\n",
+        prog, BENCH_MIN_TIME_NS / 1000000);
+}
+
+
+int main( int argc, char *argv[] ) {
+    const char *filter = "";
+    uint64_t min_ns = BENCH_MIN_TIME_NS;
+    int opt;
+
+    while( (opt = getopt(argc, argv, "f:t:")) != -1 ) {
+        switch( opt ) {
+            case 'f': filter = optarg; break;
+            case 't': min_ns = strtoull(optarg, NULL, 10) * 1000000; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if( optind != argc ) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    regex_t re;
+    if( regcomp(&re, filter, REG_EXTENDED | REG_NOSUB) != 0 ) {
+        fprintf(stderr, "invalid regex '%s'\n", filter);
+        return 1;
+    }
+
+    init_device();
+    printf("%s\n", PROGNAME " " VERSION);
+    printf("%-24s %13s %13s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+    printf("-----------------------------------------------------------------\n");
+    for( size_t i = 0; i < sizeof(benches) / sizeof(*benches); i++ ) {
+        if( regexec(&re, benches[i].name, 0, NULL, 0) == 0 ) {
+            bench(benches[i], min_ns);
+        }
+    }
+    regfree(&re);
+    return 0;
+}
+
+#endif
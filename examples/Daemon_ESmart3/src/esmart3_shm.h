@@ -0,0 +1,63 @@
+#ifndef ESMART3_SHM
+#define ESMART3_SHM
+
+/*
+Shared memory published by esmart3d for local readers
+
+One slot per item (indexed by ESmart3::item_t) is an ESmart3Snapshot (seqlock, see esmart3_snapshot.h):
+readers always get a consistent value without locks, system calls or touching the bus,
+and the version tells them cheaply if an item changed.
+
+Readers map the segment read only:
+    int fd = shm_open(ESMART3_SHM_NAME, O_RDONLY, 0);
+    const esmart3_shm_t *shm = (const esmart3_shm_t *)mmap(0, sizeof(esmart3_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    esmart3_shm_value_t value;
+    uint32_t version;
+    if( esmart3_shm_valid(*shm) && shm->slot[ESmart3::ChgSts].read(value, &version) && value.size ) {
+        const ESmart3::ChgSts_t *data = (const ESmart3::ChgSts_t *)value.data;
+    }
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+#include <esmart3_snapshot.h>  // includes <atomic> with natural alignment
+
+#pragma pack(push)
+#pragma pack()  // natural alignment for the atomics (esmart3.h packs its structures)
+
+#define ESMART3_SHM_NAME "/esmart3"
+#define ESMART3_SHM_MAGIC 0xe5e3d004  // changes with the layout
+
+enum { ESMART3_SHM_ITEMS = ESmart3::EngSave + 1, ESMART3_SHM_DATA = sizeof(ESmart3::EngSave_t) };
+
+typedef struct esmart3_shm_value {
+    uint64_t time_ms;   // wall clock (ms since epoch) when the reply frame of the last successful read arrived, or of cache restore
+    uint32_t reads;     // successful reads since daemon start
+    uint32_t errors;    // failed reads since daemon start
+    uint32_t size;      // bytes of item structure in data, 0: data not valid
+    uint32_t cached;    // 1: data restored from the cache file (same device), not read since daemon start
+    uint8_t data[ESMART3_SHM_DATA];  // item structure as returned by ESmart3::get<Item>()
+} esmart3_shm_value_t;
+
+typedef ESmart3Snapshot<esmart3_shm_value_t> esmart3_shm_slot_t;  // its ms() is daemon millis(), readers use time_ms
+
+typedef struct esmart3_shm {
+    alignas(4) std::atomic<uint32_t> magic;  // ESMART3_SHM_MAGIC once initialized
+    uint32_t size;                // sizeof(esmart3_shm_t) of the daemon
+    alignas(4) std::atomic<int32_t> pid;     // daemon process, 0 after it stopped
+    uint64_t start_ms;            // wall clock of daemon start
+    char device[64];              // tty of the eSmart3
+    esmart3_shm_slot_t slot[ESMART3_SHM_ITEMS];
+} esmart3_shm_t;
+
+
+// True if segment is initialized with the layout of this header
+inline bool esmart3_shm_valid( const esmart3_shm_t &shm ) {
+    return shm.magic.load(std::memory_order_acquire) == ESMART3_SHM_MAGIC && shm.size == sizeof(esmart3_shm_t);
+}
+
+#pragma pack(pop)
+
+#endif
@@ -0,0 +1,378 @@
+/*
+esmart3d: Linux daemon that owns the eSmart3 tty and publishes item snapshots in shared memory
+
+Polls ChgSts every interval, BatParam, LoadParam, ProParam, Log and Parameters every param interval
+and Information every 10 minutes. Each successful read is published into a seqlock guarded slot
+(ESmart3Snapshot) of a shared memory segment (see esmart3_shm.h), so any number of local readers (exporter, UI, logger)
+get consistent values without touching the bus or a socket.
+With a cache file, identity and parameters of the last run are published right after a short serial number check.
+
+Usage: esmart3d [-r] [-i interval_ms] [-p param_s] [-m shm_name] [-c cache_file] tty | -s
+       esmart3d -q [-m shm_name]
+    -r  kernel RS485 direction control (TIOCSRS485)
+    -c  fast boot: keep Information, parameters and command delay in cache_file
+    -s  simulate eSmart3 on a pty
+    -q  query: print snapshot of a running daemon and read cost
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+#include <esmart3.h>
+#include <esmart3_cache.h>
+#include <esmart3_clock.h>
+#include <esmart3_sim.h>
+#include <esmart3_tty.h>
+
+#include "esmart3_shm.h"
+
+#include <errno.h>
+#include <new>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+static const char *item_names[ESMART3_SHM_ITEMS] = {
+    "ChgSts", "BatParam", "Log", "Parameters", "LoadParam", "ChgDebug",
+    "RemoteControl", "ProParam", "Information", "TempParam", "EngSave"
+};
+
+static volatile sig_atomic_t running = 1;
+static ESmart3Cache cache;
+static ESmart3Clock sample_clock;  // maps frame reception millis() to wall clock
+static const char *cache_file = 0;  // no cache if 0
+
+static void stop( int sig ) {
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t wallclock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+// Polling
+
+typedef struct poll {
+    ESmart3::item_t item;
+    uint32_t interval;  // ms
+    uint32_t next;      // millis() when due
+    bool failing;       // last read failed (log only state changes)
+} poll_t;
+
+// Read item into data. Return false on errors or if item is not supported
+static bool get_item( ESmart3 &esmart3, ESmart3::item_t item, uint8_t *data, uint32_t &size ) {
+    switch( item ) {
+        case ESmart3::ChgSts:      size = sizeof(ESmart3::ChgSts_t);      return esmart3.getChgSts(*(ESmart3::ChgSts_t *)data);
+        case ESmart3::BatParam:    size = sizeof(ESmart3::BatParam_t);    return esmart3.getBatParam(*(ESmart3::BatParam_t *)data);
+        case ESmart3::Log:         size = sizeof(ESmart3::Log_t);         return esmart3.getLog(*(ESmart3::Log_t *)data);
+        case ESmart3::Parameters:  size = sizeof(ESmart3::Parameters_t);  return esmart3.getParameters(*(ESmart3::Parameters_t *)data);
+        case ESmart3::LoadParam:   size = sizeof(ESmart3::LoadParam_t);   return esmart3.getLoadParam(*(ESmart3::LoadParam_t *)data);
+        case ESmart3::ProParam:    size = sizeof(ESmart3::ProParam_t);    return esmart3.getProParam(*(ESmart3::ProParam_t *)data);
+        case ESmart3::Information: size = sizeof(ESmart3::Information_t); return esmart3.getInformation(*(ESmart3::Information_t *)data);
+        case ESmart3::EngSave:     size = sizeof(ESmart3::EngSave_t);     return esmart3.getEngSave(*(ESmart3::EngSave_t *)data);
+        default: return false;
+    }
+}
+
+// Cached copy of item (Information or parameters). Return false if it is not cached for the connected device
+static bool get_cached( ESmart3::item_t item, uint8_t *data, uint32_t &size ) {
+    switch( item ) {
+        case ESmart3::BatParam:    size = sizeof(ESmart3::BatParam_t);    return cache.get(*(ESmart3::BatParam_t *)data);
+        case ESmart3::Parameters:  size = sizeof(ESmart3::Parameters_t);  return cache.get(*(ESmart3::Parameters_t *)data);
+        case ESmart3::LoadParam:   size = sizeof(ESmart3::LoadParam_t);   return cache.get(*(ESmart3::LoadParam_t *)data);
+        case ESmart3::ProParam:    size = sizeof(ESmart3::ProParam_t);    return cache.get(*(ESmart3::ProParam_t *)data);
+        case ESmart3::Information: size = sizeof(ESmart3::Information_t); return cache.get(*(ESmart3::Information_t *)data);
+        default: return false;
+    }
+}
+
+// Remember item in cache. Return true if the cache changed
+static bool update_cache( ESmart3::item_t item, const uint8_t *data ) {
+    switch( item ) {
+        case ESmart3::BatParam:    return cache.update(*(const ESmart3::BatParam_t *)data);
+        case ESmart3::Parameters:  return cache.update(*(const ESmart3::Parameters_t *)data);
+        case ESmart3::LoadParam:   return cache.update(*(const ESmart3::LoadParam_t *)data);
+        case ESmart3::ProParam:    return cache.update(*(const ESmart3::ProParam_t *)data);
+        case ESmart3::Information: return cache.update(*(const ESmart3::Information_t *)data);
+        default: return false;
+    }
+}
+
+static bool load_cache() {
+    ESmart3Cache::state_t state;
+    FILE *file = fopen(cache_file, "rb");
+    if( !file ) {
+        return false;
+    }
+    bool rc = fread(&state, sizeof(state), 1, file) == 1 && cache.restore(state);
+    fclose(file);
+    return rc;
+}
+
+// Write to a temporary file and rename it, so a crash never leaves a partial cache
+static void save_cache() {
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", cache_file);
+    FILE *file = fopen(tmp, "wb");
+    bool rc = file && fwrite(&cache.state(), sizeof(ESmart3Cache::state_t), 1, file) == 1;
+    if( file && fclose(file) != 0 ) {
+        rc = false;
+    }
+    if( !rc || rename(tmp, cache_file) != 0 ) {
+        perror(cache_file);
+        unlink(tmp);
+    }
+}
+
+// Read item and publish result into its slot. A failed read keeps the last good data
+static void poll_item( ESmart3 &esmart3, esmart3_shm_t &shm, poll_t &poll ) {
+    esmart3_shm_slot_t &slot = shm.slot[poll.item];
+    esmart3_shm_value_t value = slot.value();
+
+    uint16_t data[ESMART3_SHM_DATA / 2];  // a failed read may have written parts of it
+    uint32_t size;
+    if( get_item(esmart3, poll.item, (uint8_t *)data, size) ) {
+        sample_clock.sync(wallclock_ms());  // follows steps of the system clock
+        value.time_ms = sample_clock.epochMs(esmart3.rxMillis());
+        value.reads++;
+        value.size = size;
+        value.cached = 0;
+        memcpy(value.data, data, size);
+        if( cache_file && update_cache(poll.item, value.data) ) {
+            save_cache();
+        }
+        if( poll.failing ) {
+            fprintf(stderr, "get%s ok again after %u errors\n", item_names[poll.item], value.errors);
+            poll.failing = false;
+        }
+    }
+    else {
+        value.errors++;
+        if( !poll.failing ) {
+            fprintf(stderr, "get%s error\n", item_names[poll.item]);
+            poll.failing = true;
+        }
+    }
+    slot.publish(value, esmart3.rxMillis());
+}
+
+static int run_daemon( const char *shm_name, const char *device, bool rs485, bool simulate,
+        uint32_t interval, uint32_t param_interval ) {
+    static ESmart3Sim sim;
+    if( simulate ) {
+        device = sim.begin() ? sim.device() : 0;
+        if( !device ) {
+            perror("pty");
+            return 1;
+        }
+    }
+
+    ESmart3Tty tty;
+    ESmart3 esmart3(tty);
+    if( !tty.begin(device, 9600, rs485) ) {
+        perror(device);
+        return 1;
+    }
+    esmart3.begin();  // direction by adapter or kernel
+
+    bool fast = false;
+    if( cache_file && load_cache() ) {
+        fast = cache.validate(esmart3);
+        fprintf(stderr, "esmart3d: cache %s %s\n", cache_file, fast ? "valid" : "not for this device");
+    }
+
+    int fd = shm_open(shm_name, O_CREAT | O_RDWR, 0644);
+    if( fd < 0 || ftruncate(fd, sizeof(esmart3_shm_t)) != 0 ) {
+        perror(shm_name);
+        return 1;
+    }
+    esmart3_shm_t *shm = (esmart3_shm_t *)mmap(0, sizeof(esmart3_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if( shm == MAP_FAILED ) {
+        perror("mmap");
+        return 1;
+    }
+
+    // readers see an invalid segment until it is initialized
+    shm->magic.store(0, std::memory_order_release);
+    for( size_t item = 0; item < ESMART3_SHM_ITEMS; item++ ) {
+        new (&shm->slot[item]) esmart3_shm_slot_t();
+    }
+    shm->size = sizeof(esmart3_shm_t);
+    shm->start_ms = wallclock_ms();
+    snprintf(shm->device, sizeof(shm->device), "%s", device);
+    shm->pid.store(getpid(), std::memory_order_relaxed);
+    shm->magic.store(ESMART3_SHM_MAGIC, std::memory_order_release);
+
+    uint64_t restored = wallclock_ms();
+    uint32_t now = millis();
+    poll_t polls[] = {  // in order of priority if several are due
+        { ESmart3::ChgSts,      interval,       now, false },
+        { ESmart3::Information, 600000,         now, false },
+        { ESmart3::BatParam,    param_interval, now, false },
+        { ESmart3::LoadParam,   param_interval, now, false },
+        { ESmart3::ProParam,    param_interval, now, false },
+        { ESmart3::Log,         param_interval, now, false },
+        { ESmart3::Parameters,  param_interval, now, false },
+    };
+    const size_t count = sizeof(polls) / sizeof(*polls);
+
+    // fast boot: publish cached items now and read them at their next interval
+    for( size_t i = 0; fast && i < count; i++ ) {
+        esmart3_shm_value_t value = shm->slot[polls[i].item].value();
+        if( get_cached(polls[i].item, value.data, value.size) ) {
+            value.time_ms = restored;
+            value.cached = 1;
+            shm->slot[polls[i].item].publish(value);
+            polls[i].next = now + polls[i].interval;
+        }
+    }
+    if( cache_file && cache.setCommandDelay(esmart3.commandDelay()) ) {
+        save_cache();
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    fprintf(stderr, "esmart3d: %s published at %s\n", device, shm_name);
+
+    while( running ) {
+        now = millis();
+        uint32_t wait = 1000;  // max, so a stop signal is noticed
+        bool polled = false;
+        for( size_t i = 0; i < count; i++ ) {
+            if( (int32_t)(now - polls[i].next) >= 0 ) {
+                poll_item(esmart3, *shm, polls[i]);
+                polls[i].next += polls[i].interval;
+                if( (int32_t)(millis() - polls[i].next) >= 0 ) {
+                    polls[i].next = millis() + polls[i].interval;  // fell behind: no burst of catch up reads
+                }
+                polled = true;
+                break;  // one transaction per pass, then the highest priority due poll again
+            }
+            uint32_t left = polls[i].next - now;
+            if( left < wait ) {
+                wait = left;
+            }
+        }
+        if( !polled ) {
+            delay(wait);
+        }
+    }
+
+    shm->pid.store(0, std::memory_order_release);
+    munmap(shm, sizeof(esmart3_shm_t));
+    shm_unlink(shm_name);
+    fprintf(stderr, "esmart3d: stopped\n");
+    return 0;
+}
+
+
+// Query mode: example reader
+
+static int run_query( const char *shm_name ) {
+    int fd = shm_open(shm_name, O_RDONLY, 0);
+    if( fd < 0 ) {
+        perror(shm_name);
+        return 1;
+    }
+    const esmart3_shm_t *shm = (const esmart3_shm_t *)mmap(0, sizeof(esmart3_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( shm == MAP_FAILED || !esmart3_shm_valid(*shm) ) {
+        fprintf(stderr, "%s: no esmart3d snapshot\n", shm_name);
+        return 1;
+    }
+
+    uint64_t now = wallclock_ms();
+    printf("esmart3d pid %d, device %s, up %llus\n", shm->pid.load(), shm->device,
+        (unsigned long long)(now - shm->start_ms) / 1000);
+
+    esmart3_shm_value_t value;
+    uint32_t version;
+    for( size_t item = 0; item < ESMART3_SHM_ITEMS; item++ ) {
+        if( shm->slot[item].read(value, &version) && (value.size || value.errors) ) {
+            printf("%-12s version %6u, reads %6u, errors %4u, age %6.1fs%s\n", item_names[item], version,
+                value.reads, value.errors, value.size ? (now - value.time_ms) / 1000.0 : 0.0, value.cached ? " (cached)" : "");
+        }
+    }
+
+    if( shm->slot[ESmart3::ChgSts].read(value, &version) && value.size ) {
+        size_t count;
+        const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+        printf("ChgSts");
+        for( size_t i = 0; i < count; i++ ) {
+            printf(" %s=%d", fields[i].name, ESmart3::value(value.data, fields[i]));
+        }
+        printf("\n");
+    }
+
+    // cost of a consistent snapshot copy
+    const unsigned reads = 100000;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for( unsigned i = 0; i < reads; i++ ) {
+        shm->slot[ESmart3::ChgSts].read(value, &version);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / reads;
+    printf("snapshot read %.0fns\n", ns);
+
+    return 0;
+}
+
+
+static void usage( const char *prog ) {
+    fprintf(stderr, "Usage: %s [-r] [-i interval_ms] [-p param_s] [-m shm_name] [-c cache_file] tty | -s\n"
+        "       %s -q [-m shm_name]\n"
+        "    -r  kernel RS485 direction control (TIOCSRS485)\n"
+        "    -c  fast boot: keep Information, parameters and command delay in cache_file\n"
+        "    -s  simulate eSmart3 on a pty\n"
+        "    -q  query: print snapshot of a running daemon\n", prog, prog);
+}
+
+int main( int argc, char *argv[] ) {
+    const char *shm_name = ESMART3_SHM_NAME;
+    bool rs485 = false;
+    bool simulate = false;
+    bool query = false;
+    uint32_t interval = 1000;
+    uint32_t param_interval = 60000;
+
+    int opt;
+    while( (opt = getopt(argc, argv, "ri:p:m:c:sq")) != -1 ) {
+        switch( opt ) {
+            case 'r': rs485 = true; break;
+            case 'i': interval = strtoul(optarg, 0, 0); break;
+            case 'p': param_interval = strtoul(optarg, 0, 0) * 1000; break;
+            case 'm': shm_name = optarg; break;
+            case 'c': cache_file = optarg; break;
+            case 's': simulate = true; break;
+            case 'q': query = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if( query ) {
+        return run_query(shm_name);
+    }
+    if( !simulate && optind >= argc ) {
+        usage(argv[0]);
+        return 1;
+    }
+    if( !interval || !param_interval ) {
+        fprintf(stderr, "intervals must not be 0\n");
+        return 1;
+    }
+    return run_daemon(shm_name, simulate ? 0 : argv[optind], rs485, simulate, interval, param_interval);
+}
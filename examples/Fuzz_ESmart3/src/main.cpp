@@ -0,0 +1,207 @@
+/*
+Fuzz target: feeds arbitrary bytes to ESmart3 as device replies
+
+The input is the byte stream the "device" sends. Each transaction first takes one byte that selects
+the library call (get/set/update with ranges from the input), the call then parses its reply frames
+from the following bytes. One selector instead passes a command frame from the input to the
+simulator of linux/esmart3_sim.cpp. Built with sanitizers, any out of bounds access on malformed,
+short or oversized frames is reported.
+
+Build with libFuzzer (clang):
+    clang++ -g -O1 -fsanitize=fuzzer,address,undefined -DESMART3_LIBFUZZER -Iinclude -Ilinux \
+        src/esmart3*.cpp linux/Arduino.cpp linux/esmart3_sim.cpp examples/Fuzz_ESmart3/src/main.cpp \
+        -pthread -o esmart3_fuzz
+    ./esmart3_fuzz -max_len=512 corpus/
+Without libFuzzer (gcc, AFL with afl-g++) the same file has a main() that runs the files given
+as arguments or, without arguments, random inputs (see Readme.md and make -C linux sanitize).
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+#include <esmart3.h>
+#include <esmart3_sim.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Stream that replies with the fuzz input and swallows commands
+class FuzzStream : public Stream {
+public:
+    FuzzStream( const uint8_t *data, size_t size ) : _data(data), _size(size), _pos(0) {}
+
+    size_t write( uint8_t c ) override { (void)c; return 1; }
+    using Print::write;
+
+    int available() override { return _size - _pos; }
+    int read() override { return _pos < _size ? _data[_pos++] : -1; }
+    int peek() override { return _pos < _size ? _data[_pos] : -1; }
+
+    // no timeout wait at end of input
+    size_t readBytes( uint8_t *buffer, size_t length ) override {
+        size_t n = _size - _pos < length ? _size - _pos : length;
+        if( n ) {
+            memcpy(buffer, &_data[_pos], n);
+        }
+        _pos += n;
+        return n;
+    }
+
+    uint8_t next() { int c = read(); return c < 0 ? 0 : c; }
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _pos;
+};
+
+
+// Heap copies of exact size, so the address sanitizer sees every byte written beyond a structure
+template <typename T>
+static void get( FuzzStream &in, bool (ESmart3::*method)( T &, size_t, size_t ), ESmart3 &esmart3 ) {
+    T *data = new T;
+    size_t start = in.next() % 40;
+    size_t end = in.next() % 40;
+    (esmart3.*method)(*data, start, end);
+    delete data;
+}
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size ) {
+    FuzzStream in(data, size);
+    ESmart3 esmart3(in, NULL, 0);
+
+    while( in.available() ) {
+        switch( in.next() % 15 ) {
+            case 0: get(in, &ESmart3::getChgSts, esmart3); break;
+            case 1: get(in, &ESmart3::getBatParam, esmart3); break;
+            case 2: get(in, &ESmart3::getLog, esmart3); break;
+            case 3: get(in, &ESmart3::getParameters, esmart3); break;
+            case 4: get(in, &ESmart3::getLoadParam, esmart3); break;
+            case 5: get(in, &ESmart3::getProParam, esmart3); break;
+            case 6: get(in, &ESmart3::getInformation, esmart3); break;
+            case 7: get(in, &ESmart3::getEngSave, esmart3); break;
+            case 8: {
+                bool on;
+                esmart3.getLoad(on);
+                break;
+            }
+            case 9: {
+                ESmart3::tempUnit_t unit;
+                esmart3.getDisplayTemperatureUnit(unit);
+                break;
+            }
+            case 10: {  // raw execute with a small result buffer
+                size_t capacity = in.next() % (ESmart3::MAX_RESULT + 1);
+                uint8_t *result = new uint8_t[capacity ? capacity : 1];
+                uint8_t cmd[3] = { 0, 0, (uint8_t)capacity };
+                ESmart3::header_t header = { 0, ESmart3::MPPT, ESmart3::BROADCAST, ESmart3::GET, ESmart3::ChgSts, sizeof(cmd) };
+                esmart3.execute(header, cmd, capacity ? result : NULL, capacity);
+                delete[] result;
+                break;
+            }
+            case 11: {
+                ESmart3::BatParam_t *desired = new ESmart3::BatParam_t();
+                esmart3.updateBatParam(*desired, in.next() % 16, in.next() % 16);
+                delete desired;
+                break;
+            }
+            case 12: {  // any mask, also beyond the item
+                uint16_t words[32] = {0};
+                uint32_t mask = in.next() | in.next() << 8 | in.next() << 16 | (uint32_t)in.next() << 24;
+                esmart3.update((ESmart3::item_t)(in.next() % (ESmart3::EngSave + 1)), words, mask);
+                break;
+            }
+            case 13: {  // simulator side: any command frame from the input, crc made valid
+                static ESmart3Sim sim;
+                uint8_t frame[ESmart3Sim::FRAME_SIZE];
+                uint8_t out[ESmart3Sim::FRAME_SIZE];
+                size_t len = 6 + in.next() % 121;
+                for( size_t i = 0; i < len; i++ ) {
+                    frame[i] = in.next();
+                }
+                frame[5] = len - 6;
+                uint8_t crc = 0;
+                for( size_t i = 0; i < len; i++ ) {
+                    crc -= frame[i];
+                }
+                frame[len] = crc;
+                size_t n = sim.answer(frame, out);
+                if( n > sizeof(out) ) {
+                    abort();
+                }
+                break;
+            }
+            default:
+                esmart3.setLoad(in.next() & 1);
+                break;
+        }
+    }
+    return 0;
+}
+
+
+#ifndef ESMART3_LIBFUZZER
+
+// Standalone driver: run inputs from files or random inputs
+int main( int argc, char *argv[] ) {
+    static uint8_t buf[4096];
+
+    if( argc > 1 ) {
+        for( int i = 1; i < argc; i++ ) {
+            FILE *file = fopen(argv[i], "rb");
+            if( !file ) {
+                perror(argv[i]);
+                return 1;
+            }
+            size_t size = fread(buf, 1, sizeof(buf), file);
+            fclose(file);
+            LLVMFuzzerTestOneInput(buf, size);
+        }
+        printf("%d inputs ok\n", argc - 1);
+        return 0;
+    }
+
+    // random inputs: mix of random bytes and frames with valid crc but random length,
+    // so parsing also gets beyond header and crc checks
+    const unsigned runs = 20000;
+    srand(1);
+    for( unsigned run = 0; run < runs; run++ ) {
+        size_t size = 0;
+        size_t limit = rand() % 1024;
+        while( size < limit && size + 6 + 255 + 1 + 8 <= sizeof(buf) ) {
+            buf[size++] = rand();  // selects the call
+            if( rand() % 2 ) {
+                size_t frame = size;
+                uint8_t length = rand() % 4 ? rand() % 123 : rand();
+                buf[size++] = 0xaa;
+                buf[size++] = ESmart3::MPPT;
+                buf[size++] = ESmart3::BROADCAST;
+                buf[size++] = rand() % 4 ? ESmart3::ACK : rand();
+                buf[size++] = rand() % (ESmart3::EngSave + 1);
+                buf[size++] = length;
+                for( size_t i = 0; i < length; i++ ) {
+                    buf[size++] = rand();
+                }
+                uint8_t crc = 0;
+                for( size_t i = frame; i < size; i++ ) {
+                    crc -= buf[i];
+                }
+                buf[size++] = crc;
+            }
+            else {
+                for( size_t i = rand() % 8; i > 0; i-- ) {
+                    buf[size++] = rand();
+                }
+            }
+        }
+        LLVMFuzzerTestOneInput(buf, size);
+    }
+    printf("%u random inputs ok\n", runs);
+    return 0;
+}
+
+#endif
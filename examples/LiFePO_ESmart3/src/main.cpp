@@ -11,6 +11,7 @@ Use builtin led to represent load status
 #include <Arduino.h>
 
 #include <esmart3.h>
+#include <esmart3_profile.h>
 
 #if defined(ESP8266)
 #include <SoftwareSerial.h>
@@ -30,6 +31,7 @@ SoftwareSerial Serial2;  // Use SoftwareSerial port
 
 
 ESmart3 esmart3(Serial2);  // Use ESP32 HardwareSerial port Serial2 to commiunicate with RS485 adapter
+ESmart3Profile profile(esmart3);  // Keeps the LiFePO settings applied
 
 
 void setup() {
@@ -69,12 +71,14 @@ void setup() {
         batParam.wMaxChgCurr = maxDeviceCurr;  // eSmart3 40A limit
     }
     batParam.wMaxDisChgCurr = batParam.wMaxChgCurr;  // same as charge for LiFePO and eSmart3
-    if( esmart3.setBatParam(batParam) ) {
-        Serial.println("setBatParam done");
+    size_t frames = 0;
+    if( esmart3.updateBatParam(batParam, 1, sizeof(batParam) / 2 - 2, &frames) ) {
+        Serial.printf("updateBatParam done with %u writes\n", frames);
     }
     else {
-        Serial.println("setBatParam error");
+        Serial.println("updateBatParam error");
     }
+    profile.setBatParam(batParam);
 
     ESmart3::ProParam_t proParam = {0};
     proParam.wLoadOvp = 150;  // protect end device from >= 15V
@@ -83,12 +87,13 @@ void setup() {
     proParam.wBatOvp = proParam.wBatOvB + proParam.wBatOvB / 10; // protect batttery from > 10% max voltage
     proParam.wBatUvp = proParam.wLoadUvp - proParam.wLoadUvp / 10;  // protect battery 10% below wLoadUvp
     proParam.wBatUvB = proParam.wLoadUvp - 5;  // recovery slightly below wLoadUvp
-    if( esmart3.setProParam(proParam) ) {
-        Serial.println("setProParam done");
+    if( esmart3.updateProParam(proParam, 1, sizeof(proParam) / 2 - 1, &frames) ) {
+        Serial.printf("updateProParam done with %u writes\n", frames);
     }
     else {
-        Serial.println("setProParam error");
+        Serial.println("updateProParam error");
     }
+    profile.setProParam(proParam);
 }
 
 
@@ -242,7 +247,27 @@ void handle_esmart3_status() {
 }
 
 
+// re-apply LiFePO settings if they changed, e.g. at the front panel
+// each item is checked once a minute with one short read
+void handle_profile() {
+    static uint32_t prevWrites = 0;
+    static uint32_t prevErrors = 0;
+
+    profile.handle(60000);  // returns result of the last check, also if none was due
+    if( profile.errors() != prevErrors ) {
+        prevErrors = profile.errors();
+        Serial.printf("Profile check error: %u errors in %u checks\n", profile.errors(), profile.checks());
+    }
+    if( profile.writes() != prevWrites ) {
+        prevWrites = profile.writes();
+        Serial.printf("Profile drift repaired: %u drifts, %u writes in %u checks\n", 
+            profile.drifts(), profile.writes(), profile.checks());
+    }
+}
+
+
 void loop() {
     handle_load_button(handle_load_led());
     handle_esmart3_status();
+    handle_profile();
 }
@@ -0,0 +1,109 @@
+/*
+Poll an eSmart3 from Linux through a tty (e.g. USB-RS485 adapter on a Raspberry Pi or x86 gateway)
+
+Prints Information once and then ChgSts with transaction time every interval.
+With -s a simulated eSmart3 answers on a pty pair instead, so the tty transport
+and the library can be checked without hardware.
+
+Usage: esmart3_linux [-r] [-i interval_ms] [-n count] tty | -s
+    -r  kernel RS485 direction control (TIOCSRS485) for adapters without automatic direction
+    -s  simulate eSmart3 on a pty
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+#include <esmart3.h>
+#include <esmart3_sim.h>
+#include <esmart3_tty.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+static void usage( const char *prog ) {
+    fprintf(stderr, "Usage: %s [-r] [-i interval_ms] [-n count] tty | -s\n"
+        "    -r  kernel RS485 direction control (TIOCSRS485)\n"
+        "    -s  simulate eSmart3 on a pty\n", prog);
+}
+
+int main( int argc, char *argv[] ) {
+    bool rs485 = false;
+    bool simulate = false;
+    uint32_t interval = 1000;
+    long count = -1;  // forever
+
+    int opt;
+    while( (opt = getopt(argc, argv, "ri:n:s")) != -1 ) {
+        switch( opt ) {
+            case 'r': rs485 = true; break;
+            case 'i': interval = strtoul(optarg, 0, 0); break;
+            case 'n': count = strtol(optarg, 0, 0); break;
+            case 's': simulate = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    static ESmart3Sim sim;
+    const char *device = 0;
+    if( simulate ) {
+        device = sim.begin() ? sim.device() : 0;
+        if( !device ) {
+            perror("pty");
+            return 1;
+        }
+        if( count < 0 ) {
+            count = 10;
+        }
+    }
+    else if( optind < argc ) {
+        device = argv[optind];
+    }
+    else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ESmart3Tty tty;
+    ESmart3 esmart3(tty);
+
+    if( !tty.begin(device, 9600, rs485) ) {
+        perror(device);
+        return 1;
+    }
+    esmart3.begin();  // direction by adapter or kernel
+    printf("%s: rs485 %s, low latency %s\n", device, rs485 ? "kernel" : "adapter", tty.lowLatency() ? "on" : "off");
+
+    ESmart3::Information_t info;
+    if( !esmart3.getInformation(info) ) {
+        fprintf(stderr, "getInformation failed\n");
+        return 2;
+    }
+    printf("Serial %.8s, Model %.16s, Date %.8s, FirmWare %.4s\n",
+        (char *)info.wSerial, (char *)info.wModel, (char *)info.wDate, (char *)info.wFirmWare);
+
+    uint32_t errors = 0;
+    for( long n = 0; count < 0 || n < count; n++ ) {
+        ESmart3::ChgSts_t data;
+        uint32_t start = micros();
+        if( esmart3.getChgSts(data) ) {
+            uint32_t us = micros() - start;
+            printf("ChgSts %5.1fms: Mode %u, PvVolt %u, BatVolt %u, ChgCurr %u, ChgPower %u, LoadCurr %u, BatCap %u, Fault %04x\n",
+                us / 1000.0, data.wChgMode, data.wPvVolt, data.wBatVolt, data.wChgCurr, data.wChgPower,
+                data.wLoadCurr, data.wBatCap, data.wFault);
+        }
+        else {
+            fprintf(stderr, "getChgSts failed\n");
+            errors++;
+        }
+        fflush(stdout);
+        if( count < 0 || n + 1 < count ) {
+            delay(interval);
+        }
+    }
+
+    return errors ? 2 : 0;
+}
@@ -0,0 +1,47 @@
+# Generate src/index_html.h from web/index.html: gzip compressed, with strong ETag
+# Runs as PlatformIO pre script or standalone: python gen_assets.py
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")
+    project_dir = env.subst("$PROJECT_DIR")
+except NameError:
+    project_dir = os.path.dirname(os.path.abspath(__file__))
+
+source = os.path.join(project_dir, "web", "index.html")
+target = os.path.join(project_dir, "src", "index_html.h")
+
+with open(source, "rb") as f:
+    html = f.read()
+
+data = gzip.compress(html, compresslevel=9, mtime=0)
+etag = hashlib.sha1(html).hexdigest()[:16]
+
+lines = []
+for i in range(0, len(data), 16):
+    lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+
+header = """// Generated by gen_assets.py from web/index.html, do not edit
+#ifndef INDEX_HTML_H
+#define INDEX_HTML_H
+
+#define INDEX_HTML_ETAG "\\"%s\\""
+
+static const uint8_t index_html_gz[] PROGMEM = {
+%s
+};
+
+#endif
+""" % (etag, "\n".join(lines))
+
+old = None
+if os.path.exists(target):
+    with open(target) as f:
+        old = f.read()
+if old != header:
+    with open(target, "w") as f:
+        f.write(header)
+    print("Generated %s (%d bytes html, %d bytes gzip)" % (target, len(html), len(data)))
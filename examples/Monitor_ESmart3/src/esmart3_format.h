@@ -0,0 +1,141 @@
+#ifndef ESMART3_FORMAT
+#define ESMART3_FORMAT
+
+/*
+Serializers of ChgSts samples: json, influx line and mqtt field payloads
+
+Used by Monitor_ESmart3 to publish and by Benchmark_ESmart3 to measure them,
+so the benchmark always runs the code the monitor ships.
+VERSION must be defined as a json number string, e.g. -DVERSION='"1.0"' in platformio.ini.
+
+Usage:
+    char json[512];
+    if (format_json_ChgSts(json, sizeof(json), (char *)information.wSerial, data)) publish(json);
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+#include <stdio.h>
+
+
+// Retained mqtt topic per ChgSts field, published only if value moved beyond deadband
+typedef struct mqtt_field {
+    uint16_t deadband;  // publish if raw value differs at least this much from last published
+    uint8_t decimals;   // raw value is in 1/10 units if 1
+    const char *unit;   // for auto discovery, NULL if none
+    const char *cls;    // home assistant device class, NULL if none
+} mqtt_field_t;
+
+// Same order as ESmart3::fields(ESmart3::ChgSts)
+static const mqtt_field_t mqtt_fields[] = {
+    { 1, 0, NULL, NULL },              // ChgMode
+    { 5, 1, "V", "voltage" },          // PvVolt
+    { 1, 1, "V", "voltage" },          // BatVolt
+    { 1, 1, "A", "current" },          // ChgCurr
+    { 1, 1, "V", "voltage" },          // OutVolt
+    { 1, 1, "V", "voltage" },          // LoadVolt
+    { 1, 1, "A", "current" },          // LoadCurr
+    { 5, 0, "W", "power" },            // ChgPower
+    { 2, 0, "W", "power" },            // LoadPower
+    { 1, 0, "°C", "temperature" },     // BatTemp
+    { 1, 0, "°C", "temperature" },     // InnerTemp
+    { 1, 0, "%", "battery" },          // BatCap
+    { 1, 0, NULL, NULL },              // CO2
+    { 1, 0, NULL, NULL },              // Fault
+    { 1, 0, NULL, NULL }               // SystemReminder
+};
+
+#define MQTT_FIELDS (sizeof(mqtt_fields) / sizeof(*mqtt_fields))
+
+
+// Format value of ChgSts field i (as returned by ESmart3::value()) as mqtt payload
+inline void format_field( char *payload, size_t maxlen, size_t i, const ESmart3::field_t &field, int32_t value ) {
+    if (i < MQTT_FIELDS && mqtt_fields[i].decimals) {
+        snprintf(payload, maxlen, "%.1f", value / 10.0);
+    }
+    else if (field.type == ESmart3::U32) {
+        snprintf(payload, maxlen, "%u", (uint32_t)value);
+    }
+    else {
+        snprintf(payload, maxlen, "%d", (int)value);
+    }
+}
+
+
+// Return fault bits as "0100000000" (first char is bit 0). Formatted only if fault differs from last call
+inline const char *fault_string( uint16_t fault ) {
+    static uint16_t prev = 0;
+    static char str[11] = "0000000000";
+
+    if (fault != prev) {
+        prev = fault;
+        for (size_t bit = 0; bit < sizeof(str) - 1; bit++) {
+            str[bit] = (fault & (1 << bit)) ? '1' : '0';
+        }
+    }
+    return str;
+}
+
+
+// Format ChgSts of device serial (8 chars, not terminated) as json. Return false if truncated
+inline bool format_json_ChgSts( char *json, size_t maxlen, const char *serial, const ESmart3::ChgSts_t &data ) {
+    static const char jsonFmt[] =
+        "{\"Version\":" VERSION ",\"Serial\":\"%.8s\",\"ChgSts\":{"
+        "\"ChgMode\":%u,"
+        "\"PvVolt\":%u,"
+        "\"BatVolt\":%u,"
+        "\"ChgCurr\":%u,"
+        "\"OutVolt\":%u,"
+        "\"LoadVolt\":%u,"
+        "\"LoadCurr\":%u,"
+        "\"ChgPower\":%u,"
+        "\"LoadPower\":%u,"
+        "\"BatTemp\":%d,"
+        "\"InnerTemp\":%d,"
+        "\"BatCap\":%u,"
+        "\"CO2\":%u,"
+        "\"Fault\":\"%s\","
+        "\"SystemReminder\":%u}}";
+
+    int len = snprintf(json, maxlen, jsonFmt, serial,
+        data.wChgMode, data.wPvVolt, data.wBatVolt, data.wChgCurr, data.wOutVolt,
+        data.wLoadVolt, data.wLoadCurr, data.wChgPower, data.wLoadPower, data.wBatTemp,
+        data.wInnerTemp, data.wBatCap, data.dwCO2, fault_string(data.wFault), data.wSystemReminder);
+
+    return len >= 0 && (size_t)len < maxlen;
+}
+
+
+// Format ChgSts of device serial as influx line sent by host. time is " <epoch ms>" or "". Return false if truncated
+inline bool format_line_ChgSts( char *line, size_t maxlen, const char *serial, const char *host,
+        const ESmart3::ChgSts_t &data, const char *time ) {
+    static const char lineFmt[] =
+        "ChgSts,Serial=%.8s,Version=" VERSION " "
+        "Host=\"%s\","
+        "ChgMode=%u,"
+        "PvVolt=%u,"
+        "BatVolt=%u,"
+        "ChgCurr=%u,"
+        "OutVolt=%u,"
+        "LoadVolt=%u,"
+        "LoadCurr=%u,"
+        "ChgPower=%u,"
+        "LoadPower=%u,"
+        "BatTemp=%d,"
+        "InnerTemp=%d,"
+        "BatCap=%u,"
+        "CO2=%u,"
+        "Fault=\"%s\","
+        "SystemReminder=%u%s";
+
+    int len = snprintf(line, maxlen, lineFmt, serial, host,
+        data.wChgMode, data.wPvVolt, data.wBatVolt, data.wChgCurr, data.wOutVolt,
+        data.wLoadVolt, data.wLoadCurr, data.wChgPower, data.wLoadPower, data.wBatTemp,
+        data.wInnerTemp, data.wBatCap, data.dwCO2, fault_string(data.wFault), data.wSystemReminder, time);
+
+    return len >= 0 && (size_t)len < maxlen;
+}
+
+#endif
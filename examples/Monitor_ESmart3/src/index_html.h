@@ -0,0 +1,84 @@
+// Generated by gen_assets.py from web/index.html, do not edit
+#ifndef INDEX_HTML_H
+#define INDEX_HTML_H
+
+#define INDEX_HTML_ETAG "\"b267e53e54919bf4\""
+
+static const uint8_t index_html_gz[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x8d, 0x57, 0x59, 0x6f, 0xdb, 0x46,
+    0x10, 0x7e, 0xcf, 0xaf, 0x98, 0xb2, 0x06, 0x48, 0xc2, 0x3a, 0x2c, 0x17, 0x41, 0x03, 0x8b, 0x62,
+    0x00, 0xbb, 0x0e, 0xec, 0xc2, 0xad, 0x8d, 0xc8, 0x28, 0x50, 0x04, 0x79, 0x58, 0x91, 0x4b, 0x72,
+    0x1b, 0x72, 0x97, 0x58, 0xae, 0x24, 0x0b, 0x81, 0xff, 0x7b, 0x67, 0x76, 0x49, 0x1d, 0xb1, 0x8e,
+    0xbc, 0x58, 0xcb, 0x99, 0xf9, 0xbe, 0xb9, 0xf6, 0x18, 0x47, 0xbf, 0xfc, 0xf1, 0x78, 0xf3, 0xfc,
+    0xef, 0xd3, 0x2d, 0x14, 0xa6, 0x2a, 0xe3, 0x77, 0x91, 0xfb, 0x81, 0xa8, 0xe0, 0x2c, 0xc5, 0x5f,
+    0x88, 0x2a, 0x6e, 0x18, 0x24, 0x05, 0xd3, 0x0d, 0x37, 0x13, 0x6f, 0x6e, 0xb2, 0xfe, 0x07, 0x6f,
+    0xa3, 0x90, 0xac, 0xe2, 0x13, 0x6f, 0x21, 0xf8, 0xb2, 0x56, 0xda, 0x78, 0x90, 0x28, 0x69, 0xb8,
+    0x44, 0xc3, 0xa5, 0x48, 0x4d, 0x31, 0x49, 0xf9, 0x42, 0x24, 0xbc, 0x6f, 0x3f, 0x7a, 0x20, 0xa4,
+    0x30, 0x82, 0x95, 0xfd, 0x26, 0x61, 0x25, 0x9f, 0x8c, 0x1c, 0x8d, 0x11, 0xa6, 0xe4, 0x31, 0x9f,
+    0x56, 0x4c, 0x9b, 0xdf, 0xa2, 0xa1, 0xfb, 0x24, 0x45, 0x63, 0x56, 0x6e, 0x05, 0x33, 0x95, 0xae,
+    0xe0, 0x3b, 0x64, 0xc8, 0xdd, 0xcf, 0x58, 0x25, 0xca, 0xd5, 0x15, 0x34, 0x4c, 0x36, 0xfd, 0x86,
+    0x6b, 0x91, 0x8d, 0x01, 0xa1, 0xb9, 0x90, 0x57, 0x30, 0xe2, 0xd5, 0x18, 0x5e, 0x09, 0x61, 0xd8,
+    0xac, 0xe4, 0x08, 0x99, 0x29, 0x9d, 0x72, 0xdd, 0x4f, 0x54, 0x59, 0xb2, 0xba, 0xe1, 0x57, 0xd0,
+    0xad, 0x3a, 0x50, 0x7f, 0xa6, 0x8c, 0x51, 0xd5, 0x0e, 0x36, 0x45, 0x60, 0xcd, 0xd2, 0x54, 0xc8,
+    0xfc, 0x0a, 0x2e, 0xeb, 0x17, 0xf8, 0x50, 0xbf, 0xac, 0x75, 0x83, 0x05, 0x6a, 0x0d, 0x7f, 0x31,
+    0x7d, 0x56, 0x8a, 0x1c, 0x9d, 0x6a, 0x91, 0x17, 0x66, 0xbc, 0x1b, 0x5c, 0xa5, 0xa4, 0x6a, 0x6a,
+    0x96, 0xf0, 0x16, 0xf6, 0x6b, 0xd5, 0xe4, 0x08, 0xab, 0xd0, 0x5f, 0xc1, 0xc9, 0x1e, 0xfd, 0x0d,
+    0x2e, 0xc9, 0xa3, 0x85, 0x2d, 0x5b, 0xd9, 0x4c, 0x95, 0xa9, 0x43, 0x44, 0xc3, 0x2e, 0xfb, 0x68,
+    0xd8, 0x76, 0x22, 0xa2, 0x2a, 0xd8, 0xc2, 0x14, 0x23, 0x10, 0xe9, 0xc4, 0xb3, 0x95, 0xf2, 0x36,
+    0x95, 0x2b, 0x46, 0x56, 0x5b, 0xdb, 0x92, 0x45, 0xb3, 0x39, 0xe6, 0x25, 0x41, 0xc9, 0xa4, 0x14,
+    0xc9, 0xb7, 0x89, 0x57, 0xab, 0xc6, 0x04, 0xbe, 0x92, 0x7e, 0xe8, 0xc5, 0x0f, 0x8a, 0xa5, 0xf0,
+    0xf8, 0x77, 0x34, 0x74, 0x46, 0xc7, 0x00, 0x46, 0xe5, 0x79, 0xc9, 0x09, 0xf4, 0x6c, 0x57, 0x40,
+    0xd8, 0x9f, 0x01, 0xaa, 0x2c, 0xdb, 0xb8, 0xfa, 0xf4, 0x69, 0x1b, 0x12, 0x0d, 0x6b, 0x17, 0xa9,
+    0x4d, 0x03, 0x4b, 0xe3, 0xc5, 0x9d, 0xc8, 0xf6, 0xcd, 0xd1, 0x1a, 0x1d, 0x47, 0xa6, 0xa0, 0x86,
+    0x61, 0x25, 0xe5, 0xc4, 0xbb, 0xf4, 0xe2, 0x9b, 0x22, 0x9f, 0x9a, 0x06, 0xf7, 0x48, 0x81, 0x00,
+    0xd4, 0x3b, 0x3b, 0xbb, 0x3b, 0x88, 0xc9, 0xa9, 0x89, 0xcc, 0x74, 0xb5, 0xda, 0x4b, 0x73, 0x2b,
+    0xb9, 0xce, 0x57, 0x07, 0x69, 0x9c, 0x7a, 0x87, 0x06, 0x97, 0x5d, 0x60, 0x6f, 0x42, 0x4c, 0xe3,
+    0x7b, 0x99, 0x29, 0x5d, 0x31, 0x23, 0x94, 0x44, 0xc3, 0xd4, 0xca, 0x22, 0x06, 0x85, 0xe6, 0xd9,
+    0xc4, 0x1b, 0xfe, 0xd7, 0x28, 0x39, 0xdc, 0x32, 0xf1, 0xe2, 0x3f, 0xa7, 0x54, 0x7b, 0x16, 0x3b,
+    0xe3, 0x4d, 0x04, 0x8e, 0x6d, 0x9d, 0xe4, 0x5e, 0xa2, 0x2e, 0xc7, 0xe3, 0x1c, 0xeb, 0x0c, 0xf7,
+    0x72, 0x74, 0x09, 0x1e, 0xe7, 0xb8, 0x13, 0x8d, 0x51, 0xfa, 0x20, 0x49, 0xab, 0xfe, 0xa8, 0x79,
+    0x33, 0xd1, 0x6c, 0xe9, 0xc5, 0xf8, 0x87, 0xc8, 0xe0, 0x88, 0xdd, 0xa8, 0xf2, 0xe2, 0x51, 0x75,
+    0xd2, 0xea, 0x3d, 0x99, 0xbd, 0x3f, 0x6d, 0x57, 0xa0, 0x59, 0x71, 0x38, 0x81, 0x6b, 0x66, 0x9e,
+    0x98, 0x66, 0xd5, 0xa1, 0x0c, 0x3a, 0xfd, 0xa9, 0x42, 0x3c, 0xa8, 0xfc, 0x10, 0x05, 0xaa, 0x4e,
+    0xa1, 0xad, 0x0b, 0x6e, 0xb8, 0x3e, 0xd8, 0xd2, 0x8d, 0xc5, 0xe9, 0x48, 0x58, 0x7a, 0x34, 0xa5,
+    0xb5, 0xc1, 0xc9, 0xa8, 0xb4, 0x3a, 0x4a, 0xd4, 0xe9, 0x4f, 0xf2, 0xe0, 0x59, 0x87, 0x4c, 0xe8,
+    0x6a, 0xc9, 0x34, 0x07, 0x51, 0xb1, 0x9c, 0x83, 0x51, 0x7b, 0x58, 0xe7, 0x75, 0xca, 0x0c, 0xde,
+    0x56, 0xed, 0xe2, 0x48, 0x8e, 0x0c, 0x19, 0x1b, 0x83, 0x57, 0x1a, 0x18, 0x51, 0xf1, 0x8e, 0xca,
+    0x9e, 0xcc, 0x29, 0x89, 0x9f, 0x51, 0xea, 0x1d, 0x03, 0x2f, 0xf9, 0x0c, 0x3a, 0x2f, 0x5b, 0xe0,
+    0x93, 0x38, 0x21, 0xb3, 0x72, 0xfe, 0xb2, 0x0f, 0x7a, 0x6f, 0x35, 0xc7, 0x08, 0x9c, 0x05, 0xc5,
+    0x6d, 0xe6, 0xcd, 0x1e, 0xec, 0xd4, 0x2a, 0x7e, 0x40, 0x6f, 0xdf, 0x2a, 0x07, 0x6e, 0x6d, 0x47,
+    0x18, 0xe0, 0x45, 0xfa, 0x99, 0x97, 0x3f, 0x79, 0xf3, 0xce, 0x34, 0x67, 0xa6, 0xd8, 0xbe, 0xb3,
+    0xaf, 0x9d, 0xe4, 0x38, 0x58, 0x64, 0x10, 0xe0, 0xeb, 0x4d, 0xcd, 0x0c, 0xfc, 0xcf, 0x1c, 0x5f,
+    0x7b, 0xb8, 0x9d, 0x3e, 0x7d, 0xf4, 0xc3, 0x90, 0x9e, 0x43, 0xcb, 0xac, 0x49, 0xea, 0x87, 0x63,
+    0xc0, 0x1f, 0xaa, 0x86, 0x9a, 0x9b, 0x20, 0x08, 0x61, 0x12, 0x43, 0xa9, 0x12, 0x7b, 0xb9, 0x0d,
+    0xb4, 0x0d, 0x33, 0x08, 0x7b, 0xf0, 0xfb, 0xc5, 0xc5, 0x05, 0x9a, 0xbe, 0x52, 0xe8, 0x2d, 0xd9,
+    0xbe, 0x47, 0xa0, 0x49, 0xb4, 0xa8, 0x8d, 0x0d, 0x29, 0x9b, 0xcb, 0x84, 0x48, 0xe0, 0x2c, 0x10,
+    0x29, 0x79, 0xd5, 0xdc, 0xcc, 0xb5, 0x84, 0x54, 0x25, 0xf3, 0x0a, 0x87, 0x8a, 0x41, 0xce, 0xcd,
+    0x6d, 0xc9, 0x69, 0x79, 0xbd, 0xba, 0x4f, 0xc9, 0xa8, 0x7d, 0x5f, 0xd7, 0xc8, 0xa6, 0x50, 0xcb,
+    0x40, 0x18, 0x5e, 0xf5, 0x80, 0xf6, 0x31, 0x92, 0x90, 0x1a, 0x16, 0x4c, 0x03, 0x76, 0x95, 0xc1,
+    0x04, 0x68, 0x3f, 0x0f, 0x6a, 0x9a, 0x66, 0x02, 0x6b, 0xd1, 0x43, 0x65, 0x39, 0xe7, 0x0d, 0xaa,
+    0xc8, 0xe2, 0x0b, 0x81, 0xbf, 0xf6, 0x40, 0xab, 0x25, 0x89, 0x7c, 0x7f, 0x6c, 0x09, 0xf0, 0xf6,
+    0x86, 0x80, 0x58, 0xbe, 0x71, 0x7c, 0x24, 0x64, 0x8b, 0x09, 0x9d, 0xd9, 0x39, 0xda, 0x75, 0x1b,
+    0xc1, 0x87, 0x73, 0x6b, 0x73, 0x8e, 0xa2, 0x6e, 0x1b, 0x24, 0x25, 0x6b, 0x1a, 0x1c, 0x92, 0x3c,
+    0xab, 0x75, 0xd0, 0x2f, 0x68, 0xf4, 0x75, 0x63, 0x45, 0x3b, 0xa2, 0x75, 0x75, 0x66, 0xe3, 0x0f,
+    0x07, 0x42, 0xe2, 0x35, 0x7d, 0xf7, 0xfc, 0xd7, 0x03, 0x86, 0x41, 0x6e, 0xac, 0x76, 0x37, 0x5b,
+    0xac, 0x87, 0x33, 0x6e, 0xd3, 0xcc, 0xb8, 0x49, 0x8a, 0xc0, 0x77, 0x47, 0x98, 0x7c, 0x39, 0x26,
+    0x6c, 0xbd, 0x0c, 0x34, 0xb5, 0x49, 0x0f, 0x68, 0x72, 0x09, 0xc2, 0x56, 0x66, 0x48, 0xb6, 0x55,
+    0x32, 0x13, 0x86, 0x7b, 0xbc, 0x74, 0x7b, 0x70, 0x9f, 0x13, 0xb7, 0xaf, 0xfd, 0x5d, 0x1f, 0xa4,
+    0x59, 0xfb, 0x48, 0x49, 0xe6, 0x90, 0x9b, 0x46, 0xda, 0xd1, 0x05, 0xf3, 0x3a, 0xc3, 0x01, 0x83,
+    0x96, 0x44, 0x80, 0x81, 0xdd, 0xb8, 0xe1, 0x91, 0x5a, 0x31, 0x70, 0xcc, 0x83, 0x3b, 0xba, 0x60,
+    0xb0, 0x4c, 0x40, 0xe9, 0xa0, 0x14, 0x07, 0x3e, 0x56, 0x5a, 0xc1, 0xc2, 0x49, 0xfe, 0xc1, 0x7b,
+    0x13, 0xa3, 0x74, 0xb5, 0x7b, 0xd3, 0xa7, 0x8e, 0x27, 0x04, 0xda, 0xde, 0x67, 0x01, 0x8a, 0x71,
+    0x3f, 0xbb, 0xdf, 0x03, 0x2e, 0x6d, 0x67, 0x1c, 0xdd, 0xeb, 0xbe, 0x72, 0xd8, 0xa3, 0xc0, 0xec,
+    0xfa, 0xc7, 0x92, 0x50, 0x44, 0x4e, 0xd3, 0xa3, 0x69, 0x8f, 0x9b, 0x42, 0xa5, 0x57, 0xe0, 0x3f,
+    0x3d, 0x4e, 0x9f, 0x7d, 0x24, 0x3b, 0xd1, 0x88, 0xef, 0x54, 0x0e, 0x9c, 0x86, 0xde, 0x14, 0x03,
+    0xa7, 0xcb, 0xae, 0x07, 0xe3, 0x9d, 0x98, 0xa8, 0xff, 0xbe, 0x9b, 0x08, 0xe8, 0x54, 0xda, 0x4f,
+    0xf7, 0xb8, 0xdb, 0x43, 0xda, 0x61, 0xde, 0xb5, 0x27, 0x80, 0x2f, 0x90, 0x8f, 0x76, 0xb5, 0xe4,
+    0x4b, 0xb8, 0xa5, 0x8f, 0xa9, 0x9a, 0xeb, 0x84, 0x63, 0xe4, 0x4e, 0xe5, 0x3b, 0x5b, 0xf7, 0x31,
+    0xc0, 0x09, 0xd8, 0x1a, 0x3d, 0xe0, 0x9b, 0xcb, 0x91, 0x75, 0xed, 0xaa, 0x07, 0x7c, 0xbd, 0x71,
+    0xb6, 0x64, 0x03, 0x3a, 0x3f, 0xe1, 0x09, 0x8a, 0x36, 0xbc, 0x1d, 0x8a, 0x8d, 0x6c, 0x8b, 0x02,
+    0x27, 0xe0, 0xee, 0x66, 0xc0, 0x6b, 0xc3, 0xce, 0x61, 0x38, 0xe2, 0xda, 0x7f, 0x4e, 0xfe, 0x07,
+    0xc8, 0x13, 0x52, 0xb4, 0xb4, 0x0c, 0x00, 0x00,
+};
+
+#endif
@@ -66,6 +66,14 @@ Use pin 22 to toggle RS485 read/write
     
     // Time sync
     #include <time.h>
+    #include <sys/time.h>
+
+    // Persistent counters
+    #include <Preferences.h>
+    Preferences prefs;
+
+    // Power saving
+    #include <esp_pm.h>
 #else
     #error "No ESP8266 or ESP32, define your rs485 stream, pins and includes here!"
 #endif
@@ -94,6 +102,10 @@ PubSubClient mqtt(wifiMqtt);
 const char *mqtt_user = NULL;
 const char *mqtt_pass = NULL;
 
+#ifndef MQTT_DISCOVERY
+#define MQTT_DISCOVERY "homeassistant"  // topic prefix of home assistant auto discovery
+#endif
+
 // Breathing status LED
 const uint32_t ok_interval = 5000;
 const uint32_t err_interval = 1000;
@@ -119,32 +131,425 @@ char start_time[30];
 
 ESmart3 esmart3(rs485);  // Serial port to communicate with RS485 adapter
 
+#include <esmart3_snapshot.h>  // item data: published by the poll handlers, read torn free by any task
 
-void slog(const char *message, uint16_t pri = LOG_INFO) {
-    static bool log_infos = true;
-    
-    if (pri < LOG_INFO || log_infos) {
-        Serial.println(message);
-        syslog.log(pri, message);
+#include <esmart3_cache.h>
+
+ESmart3Cache es3Cache;  // device identity, parameters and command delay saved for a fast boot
+
+#include <esmart3_clock.h>
+
+ESmart3Clock es3Clock;  // maps millis() of received frames to wall clock ms, synced from NTP
+
+#include <esmart3_energy.h>
+
+ESmart3Energy es3Energy;  // Wh and Ah counters integrated from every ChgSts sample
+
+#include <esmart3_soc.h>
+
+// Battery for state of charge estimation, defaults fit a 100Ah 12V LiFePO battery
+#ifndef SOC_CAPACITY_MAH
+#define SOC_CAPACITY_MAH 100000
+#endif
+#ifndef SOC_EFFICIENCY
+#define SOC_EFFICIENCY 990  // per mille
+#endif
+#ifndef SOC_FULL_DV
+#define SOC_FULL_DV 138
+#endif
+#ifndef SOC_FULL_DA
+#define SOC_FULL_DA 20
+#endif
+#ifndef SOC_EMPTY_DV
+#define SOC_EMPTY_DV 120
+#endif
+
+ESmart3Soc es3Soc({ SOC_CAPACITY_MAH, SOC_EFFICIENCY, SOC_FULL_DV, SOC_FULL_DA, SOC_EMPTY_DV, 60000, 5000 });
+
+#include <esmart3_events.h>
+
+ESmart3Events es3Events;  // debounced raise/clear events of fault and reminder bits
+
+#include <esmart3_stats.h>
+
+ESmart3Stats es3Stats;  // streaming min/max/mean/stddev of ChgSts fields, moving averages over 1 and 15 minutes
+
+#include <esmart3_history.h>
+
+#if defined(ESP8266)
+ESmart3History es3History(60, 60, 24, 24);  // ChgSts history, small for ESP8266 RAM
+#else
+ESmart3History es3History;  // ChgSts history with default sizes (~32kB, in PSRAM if available)
+#endif
+
+
+// Time from a load switch request (web, mqtt or button) to the device ACK in ms
+typedef struct load_latency {
+    uint32_t last;
+    uint32_t max;
+} load_latency_t;
+
+load_latency_t load_latency = {0};
+
+
+// Switch load and measure latency since request time
+bool switch_load( bool on, uint32_t requested ) {
+    bool rc = esmart3.setLoad(on);
+    if (rc) {
+        load_latency.last = millis() - requested;
+        if (load_latency.last > load_latency.max) {
+            load_latency.max = load_latency.last;
+        }
+    }
+    return rc;
+}
+
+
+// Duty cycle: each loop pass ends with waiting until the earliest periodic work is due.
+// Handlers report their next deadline with due(). Waiting lets the idle task save power
+// (automatic light sleep on ESP32 if the framework supports it, modem sleep otherwise).
+// The load button interrupt wakes the cpu early. Light sleep only happens while waiting,
+// so rs485 replies always arrive in an awake pass (the uart of the bus cannot wake the cpu)
+#ifndef LOOP_MAX_WAIT
+#define LOOP_MAX_WAIT 50  // ms, limits response delay of web and mqtt which cannot report deadlines
+#endif
+
+uint32_t loop_wait = 0;  // ms until earliest due work, computed during a loop pass
+
+typedef struct duty {
+    uint32_t window;     // micros() at start of measurement window
+    uint32_t busy;       // us not waiting in window
+    uint16_t permille;   // of last complete window
+} duty_t;
+
+duty_t loop_duty = {0};
+
+#if defined(ESP32)
+TaskHandle_t loop_task = NULL;
+esp_pm_lock_handle_t awake_lock = NULL;  // held during loop passes, released while waiting
+
+// Button pressed: end waiting at once
+void IRAM_ATTR wakeup() {
+    BaseType_t woken = pdFALSE;
+    if (loop_task) {
+        vTaskNotifyGiveFromISR(loop_task, &woken);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+
+// Note that periodic work is due at millis() time at
+void due( uint32_t at ) {
+    int32_t wait = (int32_t)(at - millis());
+    if (wait < 0) {
+        wait = 0;
+    }
+    if ((uint32_t)wait < loop_wait) {
+        loop_wait = wait;
+    }
+}
+
+
+// Wait until next due work and update duty cycle (permille of time not waiting, per 10s window)
+void handle_duty( uint32_t pass_start ) {
+    uint32_t now = micros();
+    loop_duty.busy += now - pass_start;
+
+    uint32_t wait = loop_wait < LOOP_MAX_WAIT ? loop_wait : LOOP_MAX_WAIT;
+    loop_wait = UINT32_MAX;
+    if (wait) {
+        #if defined(ESP32)
+            if (awake_lock) {
+                esp_pm_lock_release(awake_lock);
+            }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+            if (awake_lock) {
+                esp_pm_lock_acquire(awake_lock);
+            }
+        #else
+            delay(wait);
+        #endif
+    }
+
+    now = micros();
+    uint32_t total = now - loop_duty.window;
+    if (total >= 10000000) {
+        loop_duty.permille = (uint64_t)loop_duty.busy * 1000 / total;
+        loop_duty.busy = 0;
+        loop_duty.window = now;
+    }
+}
+
+
+
+// Log classes with their own rate limit and repeat suppression
+typedef enum log_class { LC_SYSTEM, LC_ITEM, LC_DEVICE, LC_NET, LC_CLASSES } log_class_t;
+
+typedef struct log_limit {
+    const char *name;
+    uint16_t per_minute;  // sustained rate of messages
+    uint16_t burst;       // messages that can be sent at once after a quiet time
+} log_limit_t;
+
+const log_limit_t log_limits[LC_CLASSES] = {
+    { "system", 30, 20 },  // start, connects, commands
+    { "item", 6, 10 },     // changed item json
+    { "device", 2, 5 },    // rs485 errors
+    { "network", 2, 5 }    // mqtt and influx errors
+};
+
+typedef struct log_state {
+    bool started;        // class was used before
+    uint32_t tokens;     // in 1/60000 messages, refilled per ms with per_minute
+    uint32_t refilled;   // millis() of last refill
+    uint32_t hash;       // of last message
+    uint16_t pri;        // of last message
+    uint32_t repeats;    // of last message not sent yet
+    uint32_t sent;       // since last summary
+    uint32_t repeated;   // since last summary
+    uint32_t limited;    // since last summary
+} log_state_t;
+
+log_state_t log_states[LC_CLASSES] = {};
+
+
+// Write log message to serial and syslog
+void log_write(const char *message, uint16_t pri) {
+    Serial.println(message);
+    syslog.log(pri, message);
+}
+
+
+// Send pending "repeated" message of a log class
+void log_repeats(log_state_t &state, log_class_t cls) {
+    if (state.repeats) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Last %s message repeated %u times", log_limits[cls].name, state.repeats);
+        log_write(buf, state.pri);
+        state.repeats = 0;
+    }
+}
+
+
+// Log message if its class has a token left. Repeated messages are only counted
+void slog(const char *message, uint16_t pri = LOG_INFO, log_class_t cls = LC_SYSTEM) {
+    static const uint32_t token = 60000;  // one message
+
+    log_state_t &state = log_states[cls];
+    const log_limit_t &limit = log_limits[cls];
+
+    uint32_t now = millis();
+    if (!state.started) {
+        state.started = true;
+        state.tokens = limit.burst * token;
+    }
+    else {
+        uint64_t tokens = state.tokens + (uint64_t)(now - state.refilled) * limit.per_minute;
+        state.tokens = tokens > limit.burst * token ? limit.burst * token : tokens;
+    }
+    state.refilled = now;
+
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const char *c = message; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+    if (hash == state.hash && pri == state.pri) {
+        state.repeats++;
+        state.repeated++;
+        return;
+    }
+    log_repeats(state, cls);
+    state.hash = hash;
+    state.pri = pri;
+
+    if (state.tokens < token) {
+        state.limited++;
+        return;
+    }
+    state.tokens -= token;
+    state.sent++;
+    log_write(message, pri);
+}
+
+
+// Flush repeat counts and log what was suppressed every 10 minutes
+void handle_log() {
+    static const uint32_t interval = 10 * 60 * 1000;
+    static uint32_t prev = 0;
+
+    due(prev + interval);
+    uint32_t now = millis();
+    if (now - prev >= interval) {
+        prev = now;
+        for (size_t cls = 0; cls < LC_CLASSES; cls++) {
+            log_state_t &state = log_states[cls];
+            log_repeats(state, (log_class_t)cls);
+            if (state.repeated || state.limited) {
+                char buf[96];
+                snprintf(buf, sizeof(buf), "Log summary %s: %u sent, %u repeated, %u rate limited", 
+                    log_limits[cls].name, state.sent, state.repeated, state.limited);
+                log_write(buf, LOG_NOTICE);
+            }
+            state.sent = state.repeated = state.limited = 0;
+        }
+    }
+}
+
+
+// Json of items, rendered once per item version and then served from here
+typedef enum json_item { 
+    J_Information, J_ChgSts, J_Energy, J_BatParam, J_Log, J_Parameters, J_LoadParam, J_ProParam, J_ITEMS 
+} json_item_t;
+
+const char *json_names[J_ITEMS] = {
+    "Information", "ChgSts", "Energy", "BatParam", "Log", "Parameters", "LoadParam", "ProParam"
+};
+
+typedef struct json_cache {
+    uint32_t version;   // incremented on each change of item data
+    uint32_t rendered;  // version of item data in json, UINT32_MAX if never rendered
+    uint32_t seq;       // json_seq of latest change
+    char json[512];
+} json_cache_t;
+
+json_cache_t json_cache[J_ITEMS] = {};
+uint32_t json_boot = 0;  // random per boot, keeps ETags of different boots apart
+uint32_t json_seq = 0;   // incremented on each change of any item
+
+
+// Mark item data as changed. Json is rendered again on next use
+void json_changed( json_item_t item ) {
+    json_cache[item].version++;
+    json_cache[item].seq = ++json_seq;
+}
+
+
+const char *json_get( json_item_t item );
+
+
+// Server-sent events: every connected client of /events gets each new item json
+#define EVENT_CLIENTS 4
+
+WiFiClient event_clients[EVENT_CLIENTS];
+
+
+// Accept request as event stream if a client slot is free
+void events_connect() {
+    for (auto &client: event_clients) {
+        if (!client.connected()) {
+            client = web_server.client();
+            client.print("HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/event-stream\r\n"
+                         "Cache-Control: no-cache\r\n"
+                         "Connection: keep-alive\r\n"
+                         "Access-Control-Allow-Origin: *\r\n\r\n"
+                         "retry: 5000\n\n");
+            return;
+        }
     }
+    web_server.send(503, "text/plain", "Too many event clients");
+}
+
 
-    if (log_infos && millis() > 10 * 60 * 1000) {
-        log_infos = false;  // log infos only for first 10 minutes
-        slog("Switch off info level messages", LOG_NOTICE);
+// Send already serialized json as event to all clients, drop clients that cannot keep up
+void events_send( const char *event, const char *json ) {
+    size_t len = strlen(json);
+    for (auto &client: event_clients) {
+        if (client.connected()) {
+            if (client.printf("event: %s\ndata: ", event) == 0
+             || client.write((const uint8_t *)json, len) != len
+             || client.write((const uint8_t *)"\n\n", 2) != 2) {
+                client.stop();
+            }
+        }
     }
 }
 
 
-void publish( const char *topic, const char *payload ) {
-    if (mqtt.connected() && !mqtt.publish(topic, payload)) {
-        slog("Mqtt publish failed", LOG_ERR);
+// Send a comment every 15s so clients and we notice dead connections
+void handle_events() {
+    static const uint32_t interval = 15000;
+    static uint32_t prev = 0;
+
+    due(prev + interval);
+    uint32_t now = millis();
+    if (now - prev >= interval) {
+        prev = now;
+        for (auto &client: event_clients) {
+            if (client.connected() && client.write((const uint8_t *)":\n\n", 3) != 3) {
+                client.stop();
+            }
+        }
     }
 }
 
 
+void publish( const char *topic, const char *payload, bool retained = false ) {
+    if (mqtt.connected() && !mqtt.publish(topic, payload, retained)) {
+        slog("Mqtt publish failed", LOG_ERR, LC_NET);
+    }
+}
+
+
+#include "esmart3_format.h"  // ChgSts serializers, shared with Benchmark_ESmart3
+
+int32_t mqtt_published[MQTT_FIELDS];  // raw values last published
+bool mqtt_valid = false;              // mqtt_published is valid for current broker connection
+bool mqtt_discovered = false;         // discovery configs sent for current broker connection
+
+
+// Publish ChgSts fields that changed beyond their deadband
+void publish_fields( const ESmart3::ChgSts_t &data ) {
+    if (!mqtt.connected()) {
+        return;
+    }
+
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    for (size_t i = 0; i < count && i < MQTT_FIELDS; i++) {
+        int32_t value = ESmart3::value(&data, fields[i]);
+        if (mqtt_valid && abs(value - mqtt_published[i]) < mqtt_fields[i].deadband) {
+            continue;
+        }
+        char topic[64], payload[16];
+        snprintf(topic, sizeof(topic), MQTT_TOPIC "/ChgSts/%s", fields[i].name);
+        format_field(payload, sizeof(payload), i, fields[i], value);
+        if (!mqtt.publish(topic, payload, true)) {
+            slog("Mqtt publish failed", LOG_ERR, LC_NET);
+            mqtt_valid = false;  // retry all next time
+            return;
+        }
+        mqtt_published[i] = value;
+    }
+    mqtt_valid = true;
+}
+
+
+
+// Return influx line timestamp " <epoch ms>" of a sample taken at millis() ms,
+// empty if wall clock is not known yet (server stamps the point on arrival then)
+const char *line_time( uint32_t ms ) {
+    static char str[22];
+    if (!es3Clock.valid()) {
+        return "";
+    }
+    snprintf(str, sizeof(str), " %llu", (unsigned long long)es3Clock.epochMs(ms));
+    return str;
+}
+
+
+// Return time in seconds of a sample taken at millis() ms for stats, events and history
+uint32_t sample_time( uint32_t ms ) {
+    return es3Clock.valid() ? (uint32_t)(es3Clock.epochMs(ms) / 1000) : (uint32_t)time(NULL);
+}
+
+
 // Post data to InfluxDB
 bool postInflux(const char *line) {
-    static const char uri[] = "/write?db=" INFLUX_DB "&precision=s";
+    static const char uri[] = "/write?db=" INFLUX_DB "&precision=ms";
 
     http.begin(client, INFLUX_SERVER, INFLUX_PORT, uri);
     http.setUserAgent(PROGNAME);
@@ -157,8 +562,10 @@ bool postInflux(const char *line) {
 
     if (influx_status < 200 || influx_status >= 300) {
         breathe_interval = err_interval;
-        syslog.logf(LOG_ERR, "Post %s:%d%s status=%d line='%s' response='%s'",
+        char err[640];
+        snprintf(err, sizeof(err), "Post %s:%d%s status=%d line='%s' response='%s'",
             INFLUX_SERVER, INFLUX_PORT, uri, influx_status, line, payload.c_str());
+        slog(err, LOG_ERR, LC_NET);
         return false;
     }
 
@@ -182,126 +589,355 @@ bool json_Information(char *json, size_t maxlen, ESmart3::Information_t data) {
 }
 
 
-ESmart3::Information_t es3Information = {0};
+// save device identity and parameters if they changed
+void save_es3Cache() {
+    #if defined(ESP32)
+        prefs.putBytes("cache", &es3Cache.state(), sizeof(ESmart3Cache::state_t));
+    #endif
+}
+
+
+// load device identity and parameters saved before last reboot (validated at first Information poll)
+void load_es3Cache() {
+    #if defined(ESP32)
+        ESmart3Cache::state_t state;
+        if (prefs.getBytes("cache", &state, sizeof(state)) == sizeof(state) && es3Cache.restore(state)) {
+            slog("Device cache restored", LOG_NOTICE);
+        }
+    #endif
+}
+
+
+ESmart3Snapshot<ESmart3::Information_t> es3Information;
 
 // get device info once every minute
-void handle_es3Information() {
+bool handle_es3Information() {
     static const uint32_t interval = 60000;
     static uint32_t prev = 0 - interval + 0;  // check at start first
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::Information_t data = {0};
-        if (esmart3.getInformation(data)) {
-            if (strncmp((const char *)data.wSerialID, (const char *)es3Information.wSerialID, sizeof(data.wSerialID))) {
+        bool cached = !es3Information.version() && es3Cache.validate(esmart3) && es3Cache.get(data);
+        if (cached || esmart3.getInformation(data)) {
+            uint32_t rx = cached ? millis() : esmart3.rxMillis();  // sample time
+            if (es3Cache.update(data) | es3Cache.setCommandDelay(esmart3.commandDelay())) {
+                save_es3Cache();
+            }
+            if (strncmp((const char *)data.wSerialID, (const char *)es3Information.value().wSerialID, sizeof(data.wSerialID))) {
                 // found a new/different eSmart3
                 static const char lineFmt[] =
                     "Information,Serial=%.8s,Version=" VERSION " "
                     "Host=\"%s\","
                     "Model=\"%.16s\","
                     "Date=\"%.8s\","
-                    "FirmWare=\"%.4s\"";
+                    "FirmWare=\"%.4s\"%s";
 
-                es3Information = data;
-                json_Information(msg, sizeof(msg), data);
-                Serial.println(msg);
-                syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/Information", msg);
+                es3Information.publish(data, rx);
+                for (size_t item = 0; item < J_ITEMS; item++) {
+                    json_changed((json_item_t)item);  // all item json contain the serial
+                }
+                const char *json = json_get(J_Information);
+                slog(json, LOG_INFO, LC_ITEM);
+                publish(MQTT_TOPIC "/json/Information", json);
+                events_send("Information", json);
                 snprintf(msg, sizeof(msg), lineFmt, (char *)data.wSerial,
                     WiFi.getHostname(), (char *)data.wModel,
-                    (char *)data.wDate, (char *)data.wFirmWare);
+                    (char *)data.wDate, (char *)data.wFirmWare, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getInformation error");
+            slog("getInformation error", LOG_ERR, LC_DEVICE);
         }
+        return true;
     }
+    return false;
 }
 
 
 bool json_ChgSts(char *json, size_t maxlen, ESmart3::ChgSts_t data) {
+    return format_json_ChgSts(json, maxlen, (char *)es3Information.value().wSerial, data);
+}
+
+
+bool json_Event(char *json, size_t maxlen, const ESmart3Events::event_t &event) {
     static const char jsonFmt[] =
-        "{\"Version\":" VERSION ",\"Serial\":\"%.8s\",\"ChgSts\":{"
-        "\"ChgMode\":%u,"
-        "\"PvVolt\":%u,"
-        "\"BatVolt\":%u,"
-        "\"ChgCurr\":%u,"
-        "\"OutVolt\":%u,"
-        "\"LoadVolt\":%u,"
-        "\"LoadCurr\":%u,"
-        "\"ChgPower\":%u,"
-        "\"LoadPower\":%u,"
-        "\"BatTemp\":%d,"
-        "\"InnerTemp\":%d,"
-        "\"BatCap\":%u,"
-        "\"CO2\":%u,"
-        "\"Fault\":\"%d%d%d%d%d%d%d%d%d%d\","
-        "\"SystemReminder\":%u}}";
-
-    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.wSerial,
-        data.wChgMode, data.wPvVolt, data.wBatVolt, data.wChgCurr, data.wOutVolt,
-        data.wLoadVolt, data.wLoadCurr, data.wChgPower, data.wLoadPower, data.wBatTemp, 
-        data.wInnerTemp, data.wBatCap, data.dwCO2, ESmart3::isBatteryVoltageOver(data.wFault), ESmart3::isPvVoltageOver(data.wFault),
-        ESmart3::isChargeCurrentOver(data.wFault), ESmart3::isDischargeCurrentOver(data.wFault), ESmart3::isBatteryTemperatureAlarm(data.wFault),
-        ESmart3::isInternalTemperatureAlarm(data.wFault), ESmart3::isPvVoltageLow(data.wFault), ESmart3::isBatteryVoltageLow(data.wFault),
-        ESmart3::isTripZeroProtectionTrigger(data.wFault), ESmart3::isControlByManualSwitchgear(data.wFault), data.wSystemReminder);
+        "{\"Version\":" VERSION ",\"Serial\":\"%.8s\",\"Event\":{"
+        "\"Time\":%u,"
+        "\"Source\":\"%s\","
+        "\"Bit\":%u,"
+        "\"Name\":\"%s\","
+        "\"Raised\":%s}}";
+
+    const char *name = ESmart3Events::name((ESmart3Events::source_t)event.source, event.bit);
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial, event.time,
+        event.source == ESmart3Events::FAULT ? "Fault" : "SystemReminder", event.bit, name ? name : "",
+        event.raised ? "true" : "false");
 
     return len < maxlen;
 }
 
 
-ESmart3::ChgSts_t es3ChgSts = {0};
+// Publish fault and reminder transitions not yet published
+void publish_events() {
+    static uint32_t next = 0;  // next event to publish
+
+    if (es3Events.next() - next > ESmart3Events::LOG_SIZE) {
+        next = es3Events.next() - ESmart3Events::LOG_SIZE;  // missed some
+    }
+    ESmart3Events::event_t event;
+    while (es3Events.event(next, event)) {
+        next++;
+        char json[200];
+        json_Event(json, sizeof(json), event);
+        slog(json, event.raised ? LOG_WARNING : LOG_NOTICE, LC_DEVICE);
+        publish(MQTT_TOPIC "/json/Event", json);
+        events_send("Event", json);
+    }
+}
+
+
+// Event log as json array, oldest first
+void send_events() {
+    web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    web_server.send(200, "application/json", "[");
+    uint32_t n = es3Events.next() > ESmart3Events::LOG_SIZE ? es3Events.next() - ESmart3Events::LOG_SIZE : 0;
+    ESmart3Events::event_t event;
+    for (const char *sep = ""; es3Events.event(n, event); n++, sep = ",") {
+        char json[200];
+        json_Event(json, sizeof(json), event);
+        web_server.sendContent(sep);
+        web_server.sendContent(json);
+    }
+    web_server.sendContent("]");
+    web_server.sendContent("");
+}
+
+
+ESmart3Snapshot<ESmart3::ChgSts_t> es3ChgSts;
 
 // get device status once every 1/2 second
-void handle_es3ChgSts() {
+bool handle_es3ChgSts( bool time_valid ) {
     static const uint32_t interval = 500 + 50;
     static uint32_t prev = 0 - interval;  // check at start + delay
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::ChgSts_t data = {0};
         if( esmart3.getChgSts(data) ) {
-            if( memcmp(&data, &es3ChgSts, sizeof(data) ) ) {
+            uint32_t rx = esmart3.rxMillis();  // sample time
+            es3Energy.update(data, rx);
+            es3Soc.update(data, rx);
+            es3Stats.add(data, sample_time(rx));
+            if( es3Events.update(data, sample_time(rx)) ) {
+                publish_events();
+            }
+            publish_fields(data);
+            json_cache[J_Energy].version++;  // fresh json on request, but no change for pollers
+            if( time_valid ) {
+                es3History.add(data, sample_time(rx));
+            }
+            if( memcmp(&data, &es3ChgSts.value(), sizeof(data) ) ) {
                 // values have changed: publish
-                static const char lineFmt[] =
-                    "ChgSts,Serial=%.8s,Version=" VERSION " "
-                    "Host=\"%s\","
-                    "ChgMode=%u,"
-                    "PvVolt=%u,"
-                    "BatVolt=%u,"
-                    "ChgCurr=%u,"
-                    "OutVolt=%u,"
-                    "LoadVolt=%u,"
-                    "LoadCurr=%u,"
-                    "ChgPower=%u,"
-                    "LoadPower=%u,"
-                    "BatTemp=%d,"
-                    "InnerTemp=%d,"
-                    "BatCap=%u,"
-                    "CO2=%u,"
-                    "Fault=\"%d%d%d%d%d%d%d%d%d%d\","
-                    "SystemReminder=%u";
-                
-                es3ChgSts = data;
-                json_ChgSts(msg, sizeof(msg), data);
-                Serial.println(msg);
-                syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/ChgSts", msg);
-                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.wSerial, WiFi.getHostname(), 
-                    data.wChgMode, data.wPvVolt, data.wBatVolt, data.wChgCurr, data.wOutVolt,
-                    data.wLoadVolt, data.wLoadCurr, data.wChgPower, data.wLoadPower, data.wBatTemp, 
-                    data.wInnerTemp, data.wBatCap, data.dwCO2, ESmart3::isBatteryVoltageOver(data.wFault), ESmart3::isPvVoltageOver(data.wFault),
-                    ESmart3::isChargeCurrentOver(data.wFault), ESmart3::isDischargeCurrentOver(data.wFault), ESmart3::isBatteryTemperatureAlarm(data.wFault),
-                    ESmart3::isInternalTemperatureAlarm(data.wFault), ESmart3::isPvVoltageLow(data.wFault), ESmart3::isBatteryVoltageLow(data.wFault),
-                    ESmart3::isTripZeroProtectionTrigger(data.wFault), ESmart3::isControlByManualSwitchgear(data.wFault), data.wSystemReminder);
+                es3ChgSts.publish(data, rx);
+                json_changed(J_ChgSts);
+                const char *json = json_get(J_ChgSts);
+                slog(json, LOG_INFO, LC_ITEM);
+                publish(MQTT_TOPIC "/json/ChgSts", json);
+                events_send("ChgSts", json);
+                format_line_ChgSts(msg, sizeof(msg), (char *)es3Information.value().wSerial, WiFi.getHostname(), data, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getChgSts error");
+            slog("getChgSts error", LOG_ERR, LC_DEVICE);
+        }
+        return true;
+    }
+    return false;
+}
+
+
+bool json_Energy(char *json, size_t maxlen, const ESmart3Energy &data) {
+    static const char jsonFmt[] =
+        "{\"Version\":" VERSION ",\"Serial\":\"%.8s\",\"Energy\":{"
+        "\"ChgWh\":%.3f,"
+        "\"LoadWh\":%.3f,"
+        "\"ChgAh\":%.3f,"
+        "\"LoadAh\":%.3f,"
+        "\"Gaps\":%u,"
+        "\"Soc\":%.1f,"
+        "\"SocCalibrated\":%s}}";
+
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial,
+        data.chargeWh(), data.loadWh(), data.chargeAh(), data.loadAh(), data.gaps(),
+        es3Soc.soc(), es3Soc.calibrated() ? "true" : "false");
+
+    return len < maxlen;
+}
+
+
+// Statistics of ChgSts fields PvVolt to BatCap (others are modes or bits)
+#define STATS_FIRST 1
+#define STATS_LAST 11
+
+bool json_Stat(char *json, size_t maxlen, size_t index) {
+    static const char jsonFmt[] =
+        "{\"Field\":\"%s\","
+        "\"Count\":%u,"
+        "\"Mean\":%.2f,"
+        "\"Stddev\":%.2f,"
+        "\"Min\":%d,"
+        "\"MinTime\":%u,"
+        "\"Max\":%d,"
+        "\"MaxTime\":%u,"
+        "\"Ema%u\":%.2f,"
+        "\"Ema%u\":%.2f}";
+
+    const ESmart3Stats::stat_t &stat = es3Stats.stat(index);
+    int len = snprintf(json, maxlen, jsonFmt, ESmart3Stats::fieldName(index), stat.count, stat.mean, 
+        es3Stats.stddev(index), stat.min, stat.minTime, stat.max, stat.maxTime, 
+        es3Stats.window(0), stat.ema[0], es3Stats.window(1), stat.ema[1]);
+
+    return len < maxlen;
+}
+
+
+// Statistics of current period as json array
+void send_stats() {
+    web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    web_server.send(200, "application/json", "[");
+    for (size_t index = STATS_FIRST; index <= STATS_LAST; index++) {
+        char json[256];
+        json_Stat(json, sizeof(json), index);
+        web_server.sendContent(index > STATS_FIRST ? "," : "");
+        web_server.sendContent(json);
+    }
+    web_server.sendContent("]");
+    web_server.sendContent("");
+}
+
+
+// Publish summary of each field every 15 minutes and start a new period
+// Format influx line of stats field index at millis() ms. Return its length like snprintf()
+int line_Stat( char *line, size_t maxlen, size_t index, uint32_t ms ) {
+    static const char lineFmt[] =
+        "Stats,Serial=%.8s,Version=" VERSION ",Field=%s "
+        "Host=\"%s\","
+        "Count=%u,"
+        "Mean=%.2f,"
+        "Stddev=%.2f,"
+        "Min=%d,"
+        "Max=%d%s\n";
+
+    const ESmart3Stats::stat_t &stat = es3Stats.stat(index);
+    return snprintf(line, maxlen, lineFmt, (char *)es3Information.value().wSerial,
+        ESmart3Stats::fieldName(index), WiFi.getHostname(), stat.count, stat.mean, es3Stats.stddev(index),
+        stat.min, stat.max, line_time(ms));
+}
+
+
+void handle_es3Stats() {
+    static const uint32_t interval = 15 * 60 * 1000;
+    static uint32_t prev = 0;
+
+    due(prev + interval);
+    uint32_t now = millis();
+    if( now - prev >= interval ) {
+        prev += interval;
+        static char lines[(STATS_LAST - STATS_FIRST + 1) * 160];
+        size_t len = 0;
+        for (size_t index = STATS_FIRST; index <= STATS_LAST; index++) {
+            if (!es3Stats.stat(index).count) {
+                continue;
+            }
+            char topic[64], json[256];
+            snprintf(topic, sizeof(topic), MQTT_TOPIC "/stats/%s", ESmart3Stats::fieldName(index));
+            json_Stat(json, sizeof(json), index);
+            publish(topic, json);
+            int n = line_Stat(lines + len, sizeof(lines) - len, index, now);
+            if (len && n >= 0 && (size_t)n >= sizeof(lines) - len) {
+                // lines full (e.g. long hostname): post what fits and start over with this line
+                lines[len] = '\0';
+                postInflux(lines);
+                len = 0;
+                n = line_Stat(lines, sizeof(lines), index, now);
+            }
+            if (n < 0 || (size_t)n >= sizeof(lines) - len) {
+                lines[len] = '\0';
+                snprintf(msg, sizeof(msg), "Stats line of %s too long, not posted", ESmart3Stats::fieldName(index));
+                slog(msg, LOG_ERR, LC_NET);
+                continue;
+            }
+            len += n;
+        }
+        if (len) {
+            postInflux(lines);
+        }
+        es3Stats.reset();
+    }
+}
+
+
+// save energy counters and state of charge so they survive a reboot
+void save_es3Energy() {
+    #if defined(ESP32)
+        prefs.putBytes("energy", &es3Energy.state(), sizeof(ESmart3Energy::state_t));
+        prefs.putBytes("soc", &es3Soc.state(), sizeof(ESmart3Soc::state_t));
+    #endif
+}
+
+
+// load energy counters and state of charge saved before last reboot
+void load_es3Energy() {
+    #if defined(ESP32)
+        ESmart3Energy::state_t state;
+        if (prefs.getBytes("energy", &state, sizeof(state)) == sizeof(state) && es3Energy.restore(state)) {
+            slog("Energy counters restored", LOG_NOTICE);
+        }
+        ESmart3Soc::state_t soc;
+        if (prefs.getBytes("soc", &soc, sizeof(soc)) == sizeof(soc) && es3Soc.restore(soc)) {
+            slog("State of charge restored", LOG_NOTICE);
+        }
+    #endif
+}
+
+
+// publish energy counters once every minute, save them every 10 minutes
+void handle_es3Energy() {
+    static const uint32_t interval = 60000;
+    static uint32_t prev = 0;
+    static uint32_t count = 0;
+
+    due(prev + interval);
+    uint32_t now = millis();
+    if( now - prev >= interval ) {
+        prev += interval;
+        static const char lineFmt[] =
+            "Energy,Serial=%.8s,Version=" VERSION " "
+            "Host=\"%s\","
+            "ChgWh=%.3f,"
+            "LoadWh=%.3f,"
+            "ChgAh=%.3f,"
+            "LoadAh=%.3f,"
+            "Gaps=%u,"
+            "Soc=%.1f%s";
+        json_changed(J_Energy);
+        const char *json = json_get(J_Energy);
+        publish(MQTT_TOPIC "/json/Energy", json);
+        events_send("Energy", json);
+        snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(),
+            es3Energy.chargeWh(), es3Energy.loadWh(), es3Energy.chargeAh(), es3Energy.loadAh(), es3Energy.gaps(),
+            es3Soc.soc(), line_time(millis()));
+        postInflux(msg);
+
+        if( ++count % 10 == 0 ) {
+            save_es3Energy();
         }
     }
 }
@@ -320,7 +956,7 @@ bool json_BatParam(char *json, size_t maxlen, ESmart3::BatParam_t data) {
         "\"EqualizeChgTime\":%u,"
         "\"LoadUseSel\":%u}}";
 
-    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.wSerial,
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial,
         data.wBatType, data.wBatSysType, data.wBulkVolt, data.wFloatVolt, data.wMaxChgCurr,
         data.wMaxDisChgCurr, data.wEqualizeChgVolt, data.wEqualizeChgTime, data.bLoadUseSel);
 
@@ -328,19 +964,25 @@ bool json_BatParam(char *json, size_t maxlen, ESmart3::BatParam_t data) {
 }
 
 
-ESmart3::BatParam_t es3BatParam = {0};
+ESmart3Snapshot<ESmart3::BatParam_t> es3BatParam;
 
 // get battery parameters once every 10s
-void handle_es3BatParam() {
+bool handle_es3BatParam() {
     static const uint32_t interval = 10000;
     static uint32_t prev = 0 - interval + 100;  // check at start + delay
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::BatParam_t data = {0};
-        if( esmart3.getBatParam(data) ) {
-            if( memcmp(&data, &es3BatParam, sizeof(data) ) ) {
+        bool cached = !es3BatParam.version() && es3Cache.get(data);  // fast boot: read at next interval
+        if( cached || esmart3.getBatParam(data) ) {
+            uint32_t rx = cached ? millis() : esmart3.rxMillis();  // sample time
+            if( es3Cache.update(data) ) {
+                save_es3Cache();
+            }
+            if( memcmp(&data, &es3BatParam.value(), sizeof(data) ) ) {
                 // values have changed: publish
                 static const char lineFmt[] =
                     "BatParam,Serial=%.8s,Version=" VERSION " "
@@ -353,23 +995,26 @@ void handle_es3BatParam() {
                     "MaxDisChgCurr=%u,"
                     "EqualizeChgVolt=%u,"
                     "EqualizeChgTime=%u,"
-                    "LoadUseSel=%u";
+                    "LoadUseSel=%u%s";
                 
-                es3BatParam = data;
-                json_BatParam(msg, sizeof(msg), data);
-                Serial.println(msg);
-                syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/BatParam", msg);
-                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.wSerial, WiFi.getHostname(), 
+                es3BatParam.publish(data, rx);
+                json_changed(J_BatParam);
+                const char *json = json_get(J_BatParam);
+                slog(json, LOG_INFO, LC_ITEM);
+                publish(MQTT_TOPIC "/json/BatParam", json);
+                events_send("BatParam", json);
+                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(), 
                     data.wBatType, data.wBatSysType, data.wBulkVolt, data.wFloatVolt, data.wMaxChgCurr,
-                    data.wMaxDisChgCurr, data.wEqualizeChgVolt, data.wEqualizeChgTime, data.bLoadUseSel);
+                    data.wMaxDisChgCurr, data.wEqualizeChgVolt, data.wEqualizeChgTime, data.bLoadUseSel, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getBatParam error");
+            slog("getBatParam error", LOG_ERR, LC_DEVICE);
         }
+        return !cached;  // no transaction if served from cache
     }
+    return false;
 }
 
 
@@ -391,7 +1036,7 @@ bool json_Log(char *json, size_t maxlen, ESmart3::Log_t data) {
         "\"BacklightTime\":%u,"
         "\"SwitchEnable\":%u}}";
 
-    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.wSerial,
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial,
         data.dwRunTime, data.wStartCnt, data.wLastFaultInfo, data.wFaultCnt, 
         data.dwTodayEng, data.wTodayEngDate.month, data.wTodayEngDate.day, data.dwMonthEng, 
         data.wMonthEngDate.month, data.wMonthEngDate.day, data.dwTotalEng, data.dwLoadTodayEng, 
@@ -401,19 +1046,21 @@ bool json_Log(char *json, size_t maxlen, ESmart3::Log_t data) {
 }
 
 
-ESmart3::Log_t es3Log = {0};
+ESmart3Snapshot<ESmart3::Log_t> es3Log;
 
 // get status log once every 10s
-void handle_es3Log() {
+bool handle_es3Log() {
     static const uint32_t interval = 10000;
     static uint32_t prev = 0 - interval + 150;  // check at start + delay
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::Log_t data = {0};
         if( esmart3.getLog(data) ) {
-            if( memcmp(&data.wStartCnt, &es3Log.wStartCnt, sizeof(data) - offsetof(ESmart3::Log_t, wStartCnt) ) ) {
+            uint32_t rx = esmart3.rxMillis();  // sample time
+            if( memcmp(&data.wStartCnt, &es3Log.value().wStartCnt, sizeof(data) - offsetof(ESmart3::Log_t, wStartCnt) ) ) {
                 // values have changed: publish
                 static const char lineFmt[] =
                     "Log,Serial=%.8s,Version=" VERSION " "
@@ -431,25 +1078,28 @@ void handle_es3Log() {
                     "LoadMonthEng=%u,"
                     "LoadTotalEng=%u,"
                     "BacklightTime=%u,"
-                    "SwitchEnable=%u";
+                    "SwitchEnable=%u%s";
                 
-                es3Log = data;
-                json_Log(msg, sizeof(msg), data);
-                Serial.println(msg);
-                syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/Log", msg);
-                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.wSerial, WiFi.getHostname(), 
+                es3Log.publish(data, rx);
+                json_changed(J_Log);
+                const char *json = json_get(J_Log);
+                slog(json, LOG_INFO, LC_ITEM);
+                publish(MQTT_TOPIC "/json/Log", json);
+                events_send("Log", json);
+                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(), 
                     data.dwRunTime, data.wStartCnt, data.wLastFaultInfo, data.wFaultCnt, 
                     data.dwTodayEng, data.wTodayEngDate.month, data.wTodayEngDate.day, data.dwMonthEng, 
                     data.wMonthEngDate.month, data.wMonthEngDate.day, data.dwTotalEng, data.dwLoadTodayEng, 
-                    data.dwLoadMonthEng, data.dwLoadTotalEng, data.wBacklightTime, data.bSwitchEnable);
+                    data.dwLoadMonthEng, data.dwLoadTotalEng, data.wBacklightTime, data.bSwitchEnable, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getLog error");
+            slog("getLog error", LOG_ERR, LC_DEVICE);
         }
+        return true;
     }
+    return false;
 }
 
 
@@ -469,7 +1119,7 @@ bool json_Parameters(char *json, size_t maxlen, ESmart3::Parameters_t data) {
         "\"OutVoltRatio\":%u,"
         "\"OutVoltOffset\":%u}}";
 
-    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.wSerial,
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial,
         data.wPvVoltRatio, data.wPvVoltOffset, data.wBatVoltRatio, data.wBatVoltOffset, 
         data.wChgCurrRatio, data.wChgCurrOffset, data.wLoadCurrRatio, data.wLoadCurrOffset, 
         data.wLoadVoltRatio, data.wLoadVoltOffset, data.wOutVoltRatio, data.wOutVoltOffset);
@@ -478,19 +1128,25 @@ bool json_Parameters(char *json, size_t maxlen, ESmart3::Parameters_t data) {
 }
 
 
-ESmart3::Parameters_t es3Parameters = {0};
+ESmart3Snapshot<ESmart3::Parameters_t> es3Parameters;
 
 // get calibration parameters once every 10s
-void handle_es3Parameters() {
+bool handle_es3Parameters() {
     static const uint32_t interval = 10000;
     static uint32_t prev = 0 - interval + 200;  // check at start + delay
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::Parameters_t data = {0};
-        if( esmart3.getParameters(data) ) {
-            if( memcmp(&data, &es3Parameters, sizeof(data)) ) {
+        bool cached = !es3Parameters.version() && es3Cache.get(data);  // fast boot: read at next interval
+        if( cached || esmart3.getParameters(data) ) {
+            uint32_t rx = cached ? millis() : esmart3.rxMillis();  // sample time
+            if( es3Cache.update(data) ) {
+                save_es3Cache();
+            }
+            if( memcmp(&data, &es3Parameters.value(), sizeof(data)) ) {
                 // values have changed: publish
                 static const char lineFmt[] =
                     "Parameters,Serial=%.8s,Version=" VERSION " "
@@ -506,24 +1162,28 @@ void handle_es3Parameters() {
                     "LoadVoltRatio=%u,"
                     "LoadVoltOffset=%u,"
                     "OutVoltRatio=%u,"
-                    "OutVoltOffset=%u";
+                    "OutVoltOffset=%u%s";
                 
-                es3Parameters = data;
-                json_Parameters(msg, sizeof(msg), data);
-                // Serial.println(msg);
-                // syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/Parameters", msg);
-                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.wSerial, WiFi.getHostname(), 
+                es3Parameters.publish(data, rx);
+                json_changed(J_Parameters);
+                const char *json = json_get(J_Parameters);
+                // Serial.println(json);
+                // syslog.log(LOG_INFO, json);
+                publish(MQTT_TOPIC "/json/Parameters", json);
+                events_send("Parameters", json);
+                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(), 
                     data.wPvVoltRatio, data.wPvVoltOffset, data.wBatVoltRatio, data.wBatVoltOffset, 
                     data.wChgCurrRatio, data.wChgCurrOffset, data.wLoadCurrRatio, data.wLoadCurrOffset, 
-                    data.wLoadVoltRatio, data.wLoadVoltOffset, data.wOutVoltRatio, data.wOutVoltOffset);
+                    data.wLoadVoltRatio, data.wLoadVoltOffset, data.wOutVoltRatio, data.wOutVoltOffset, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getParameters error");
+            slog("getParameters error", LOG_ERR, LC_DEVICE);
         }
+        return !cached;  // no transaction if served from cache
     }
+    return false;
 }
 
 
@@ -543,7 +1203,7 @@ bool json_LoadParam(char *json, size_t maxlen, ESmart3::LoadParam_t data) {
         "\"LoadSts\":%u,"
         "\"Time2Enable\":%u}}";
 
-    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.wSerial,
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial,
         data.wLoadModuleSelect1, data.wLoadModuleSelect2, data.wLoadOnPvVolt, data.wLoadOffPvVolt, 
         data.wPvContrlTurnOnDelay, data.wPvContrlTurnOffDelay, data.AftLoadOnTime.hour, data.AftLoadOnTime.minute, 
         data.AftLoadOffTime.hour, data.AftLoadOffTime.minute, data.MonLoadOnTime.hour, data.MonLoadOnTime.minute, 
@@ -553,19 +1213,25 @@ bool json_LoadParam(char *json, size_t maxlen, ESmart3::LoadParam_t data) {
 }
 
 
-ESmart3::LoadParam_t es3LoadParam = {0};
+ESmart3Snapshot<ESmart3::LoadParam_t> es3LoadParam;
 
 // get load parameters once every 10s
-void handle_es3LoadParam() {
+bool handle_es3LoadParam() {
     static const uint32_t interval = 10000;
     static uint32_t prev = 0 - interval + 250;  // check at start + delay
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::LoadParam_t data = {0};
-        if( esmart3.getLoadParam(data) ) {
-            if( memcmp(&data, &es3LoadParam, sizeof(data) ) ) {
+        bool cached = !es3LoadParam.version() && es3Cache.get(data);  // fast boot: read at next interval
+        if( cached || esmart3.getLoadParam(data) ) {
+            uint32_t rx = cached ? millis() : esmart3.rxMillis();  // sample time
+            if( es3Cache.update(data) ) {
+                save_es3Cache();
+            }
+            if( memcmp(&data, &es3LoadParam.value(), sizeof(data) ) ) {
                 // values have changed: publish
                 static const char lineFmt[] =
                     "LoadParam,Serial=%.8s,Version=" VERSION " "
@@ -581,25 +1247,28 @@ void handle_es3LoadParam() {
                     "MonLoadOnTime=\"%d:%d\","
                     "MonLoadOffTime=\"%d:%d\","
                     "LoadSts=%u,"
-                    "Time2Enable=%u";
+                    "Time2Enable=%u%s";
                 
-                es3LoadParam = data;
-                json_LoadParam(msg, sizeof(msg), data);
-                Serial.println(msg);
-                syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/LoadParam", msg);
-                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.wSerial, WiFi.getHostname(), 
+                es3LoadParam.publish(data, rx);
+                json_changed(J_LoadParam);
+                const char *json = json_get(J_LoadParam);
+                slog(json, LOG_INFO, LC_ITEM);
+                publish(MQTT_TOPIC "/json/LoadParam", json);
+                events_send("LoadParam", json);
+                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(), 
                     data.wLoadModuleSelect1, data.wLoadModuleSelect2, data.wLoadOnPvVolt, data.wLoadOffPvVolt, 
                     data.wPvContrlTurnOnDelay, data.wPvContrlTurnOffDelay, data.AftLoadOnTime.hour, data.AftLoadOnTime.minute, 
                     data.AftLoadOffTime.hour, data.AftLoadOffTime.minute, data.MonLoadOnTime.hour, data.MonLoadOnTime.minute, 
-                    data.MonLoadOffTime.hour, data.MonLoadOffTime.minute, data.wLoadSts, data.wTime2Enable);
+                    data.MonLoadOffTime.hour, data.MonLoadOffTime.minute, data.wLoadSts, data.wTime2Enable, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getLoadParam error");
+            slog("getLoadParam error", LOG_ERR, LC_DEVICE);
         }
+        return !cached;  // no transaction if served from cache
     }
+    return false;
 }
 
 
@@ -613,26 +1282,32 @@ bool json_ProParam(char *json, size_t maxlen, ESmart3::ProParam_t data) {
         "\"BatUvp\":%u,"
         "\"BatUvB\":%u}}";
 
-    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.wSerial,
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial,
         data.wLoadOvp, data.wLoadUvp, data.wBatOvp, data.wBatOvB, data.wBatUvp, data.wBatUvB);
 
     return len < maxlen;
 }
 
 
-ESmart3::ProParam_t es3ProParam = {0};
+ESmart3Snapshot<ESmart3::ProParam_t> es3ProParam;
 
 // get protection parameters once every 10s
-void handle_es3ProParam() {
+bool handle_es3ProParam() {
     static const uint32_t interval = 10000;
     static uint32_t prev = 0 - interval + 300;  // check at start + delay
 
+    due(prev + interval);
     uint32_t now = millis();
     if( now - prev >= interval ) {
         prev += interval;
         ESmart3::ProParam_t data = {0};
-        if( esmart3.getProParam(data) ) {
-            if( memcmp(&data, &es3ProParam, sizeof(data) ) ) {
+        bool cached = !es3ProParam.version() && es3Cache.get(data);  // fast boot: read at next interval
+        if( cached || esmart3.getProParam(data) ) {
+            uint32_t rx = cached ? millis() : esmart3.rxMillis();  // sample time
+            if( es3Cache.update(data) ) {
+                save_es3Cache();
+            }
+            if( memcmp(&data, &es3ProParam.value(), sizeof(data) ) ) {
                 // values have changed: publish
                 static const char lineFmt[] =
                     "ProParam,Serial=%.8s,Version=" VERSION " "
@@ -642,192 +1317,393 @@ void handle_es3ProParam() {
                     "BatOvp=%u,"
                     "BatOvB=%u,"
                     "BatUvp=%u,"
-                    "BatUvB=%u";
+                    "BatUvB=%u%s";
                 
-                es3ProParam = data;
-                json_ProParam(msg, sizeof(msg), data);
-                Serial.println(msg);
-                syslog.log(LOG_INFO, msg);
-                publish(MQTT_TOPIC "/json/ProParam", msg);
-                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.wSerial, WiFi.getHostname(), 
-                    data.wLoadOvp, data.wLoadUvp, data.wBatOvp, data.wBatOvB, data.wBatUvp, data.wBatUvB);
+                es3ProParam.publish(data, rx);
+                json_changed(J_ProParam);
+                const char *json = json_get(J_ProParam);
+                slog(json, LOG_INFO, LC_ITEM);
+                publish(MQTT_TOPIC "/json/ProParam", json);
+                events_send("ProParam", json);
+                snprintf(msg, sizeof(msg), lineFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(), 
+                    data.wLoadOvp, data.wLoadUvp, data.wBatOvp, data.wBatOvB, data.wBatUvp, data.wBatUvB, line_time(rx));
                 postInflux(msg);
             }
         }
         else {
-            Serial.println("getProParam error");
+            slog("getProParam error", LOG_ERR, LC_DEVICE);
         }
+        return !cached;  // no transaction if served from cache
     }
+    return false;
 }
 
 
-// Standard web page
-const char *main_page( const char *body ) {
-    static const char fmt[] =
-        "<html>\n"
-        " <head>\n"
-        "  <title>" PROGNAME " %.8s v" VERSION "</title>\n"
-        "  <meta http-equiv=\"expires\" content=\"5\">\n"
-        " </head>\n"
-        " <body>\n"
-        "  <h1>" PROGNAME " %.8s v" VERSION "</h1>\n"
-        "  <p><table><tr>\n"
-        "   <td><form action=\"on\" method=\"post\">\n"
-        "    <input type=\"submit\" name=\"on\" value=\"Load ON\" />\n"
-        "   </form></td>\n"
-        "   <td><form action=\"toggle\" method=\"post\">\n"
-        "    <input type=\"submit\" name=\"toggle\" value=\"Toggle Load\" />\n"
-        "   </form></td>\n"
-        "   <td><form action=\"off\" method=\"post\">\n"
-        "    <input type=\"submit\" name=\"off\" value=\"Load OFF\" />\n"
-        "   </form></td>\n"
-        "  </tr></table></p>\n<p>%s</p>"
-        "  <p><table>\n"
-        "   <tr><td>Information</td><td><a href=\"/json/Information\">JSON</a></td></tr>\n"
-        "   <tr><td>ChgSts</td><td><a href=\"/json/ChgSts\">JSON</a></td></tr>\n"
-        "   <tr><td>BatParam</td><td><a href=\"/json/BatParam\">JSON</a></td></tr>\n"
-        "   <tr><td>Log</td><td><a href=\"/json/Log\">JSON</a></td></tr>\n"
-        "   <tr><td>Parameters</td><td><a href=\"/json/Parameters\">JSON</a></td></tr>\n"
-        "   <tr><td>LoadParam</td><td><a href=\"/json/LoadParam\">JSON</a></td></tr>\n"
-        "   <tr><td>ProParam</td><td><a href=\"/json/ProParam\">JSON</a></td></tr>\n"
-        "   <tr><td>Post firmware image to</td><td><a href=\"/update\">/update</a></td></tr>\n"
-        "   <tr><td>Last start time</td><td>%s</td></tr>\n"
-        "   <tr><td>Last web update</td><td>%s</td></tr>\n"
-        "   <tr><td>Last influx update</td><td>%s</td></tr>\n"
-        "   <tr><td>Influx status</td><td>%d</td></tr>\n"
-        "  </table></p>\n"
-        "  <p><table><tr>\n"
-        "   <td><form action=\"/\" method=\"get\">\n"
-        "    <input type=\"submit\" name=\"reload\" value=\"Reload\" />\n"
-        "   </form></td>\n"
-        "   <td><form action=\"breathe\" method=\"post\">\n"
-        "    <input type=\"submit\" name=\"breathe\" value=\"Toggle Breathe\" />\n"
-        "   </form></td>\n"
-        "   <td><form action=\"reset\" method=\"post\">\n"
-        "    <input type=\"submit\" name=\"reset\" value=\"Reset ESP\" />\n"
-        "   </form></td>\n"
-        "  </tr></table></p>\n"
-        " </body>\n"
-        "</html>\n";
-    static char page[sizeof(fmt) + 500] = "";
-    static char curr_time[30], influx_time[30];
+// Render json of a consistent copy of the item snapshot (zeroed if nothing is published yet)
+// If wall clock is known, "Time" (ms since epoch of frame reception) is added to the top level object
+// Return false if the poll handler was publishing: previous json is kept and rendered next time
+template <typename T>
+bool json_render( char *json, size_t maxlen, const ESmart3Snapshot<T> &snapshot, bool (*render)(char *, size_t, T) ) {
+    T data;
+    uint32_t ms;
+    if (!snapshot.read(data, 0, 100, &ms) && snapshot.version()) {
+        return false;
+    }
+    if (render(json, maxlen, data) && snapshot.version() && es3Clock.valid()) {
+        size_t len = strlen(json);  // ends with '}' of the top level object
+        if (len + 30 <= maxlen) {  // room for ,"Time":<20 digits>}
+            snprintf(json + len - 1, maxlen - len + 1, ",\"Time\":%llu}", (unsigned long long)es3Clock.epochMs(ms));
+        }
+    }
+    return true;
+}
+
+
+// Return json of item, render it if item data changed since last use
+const char *json_get( json_item_t item ) {
+    json_cache_t &cache = json_cache[item];
+    if (cache.rendered != cache.version) {
+        char *json = cache.json;
+        size_t maxlen = sizeof(cache.json);
+        bool rendered = true;
+        switch (item) {
+            case J_Information: rendered = json_render(json, maxlen, es3Information, json_Information); break;
+            case J_ChgSts: rendered = json_render(json, maxlen, es3ChgSts, json_ChgSts); break;
+            case J_Energy: json_Energy(json, maxlen, es3Energy); break;
+            case J_BatParam: rendered = json_render(json, maxlen, es3BatParam, json_BatParam); break;
+            case J_Log: rendered = json_render(json, maxlen, es3Log, json_Log); break;
+            case J_Parameters: rendered = json_render(json, maxlen, es3Parameters, json_Parameters); break;
+            case J_LoadParam: rendered = json_render(json, maxlen, es3LoadParam, json_LoadParam); break;
+            case J_ProParam: rendered = json_render(json, maxlen, es3ProParam, json_ProParam); break;
+            default: json[0] = '\0'; break;
+        }
+        if (rendered) {
+            cache.rendered = cache.version;
+        }
+    }
+    return cache.json;
+}
+
+
+// Send cached json of item with its version as ETag or 304 if client has this version
+void send_json( json_item_t item ) {
+    char etag[24];
+    json_get(item);  // make sure version and json match
+    snprintf(etag, sizeof(etag), "\"%x-%u\"", json_boot, json_cache[item].rendered);
+    if (web_server.header("If-None-Match") == etag) {
+        web_server.send(304);
+        return;
+    }
+    web_server.sendHeader("ETag", etag);
+    web_server.sendHeader("Cache-Control", "no-cache");
+    web_server.send(200, "application/json", json_cache[item].json);
+}
+
+
+// Long poll of /json/all: clients waiting for items changed since their sequence number
+#define POLL_CLIENTS 4
+
+typedef struct poll_client {
+    WiFiClient client;
+    uint32_t since;    // answer when json_seq gets bigger
+    uint32_t start;    // millis() of request
+    uint32_t timeout;  // answer with no items after this many ms
+} poll_client_t;
+
+poll_client_t poll_clients[POLL_CLIENTS];
+
+
+// Send json of all items changed after since and close the connection
+// {"Boot":"id","Seq":n,"Items":{"Name":{item json},...}}
+void poll_reply( WiFiClient &client, uint32_t since ) {
+    if (since > json_seq) {
+        since = 0;  // sequence of previous boot (client without boot=): send all
+    }
+    client.printf("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: application/json\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: close\r\n\r\n"
+                  "{\"Boot\":\"%x\",\"Seq\":%u,\"Items\":{", json_boot, json_seq);
+    const char *sep = "";
+    for (size_t item = 0; item < J_ITEMS; item++) {
+        if (json_cache[item].seq > since) {
+            client.printf("%s\"%s\":", sep, json_names[item]);
+            client.print(json_get((json_item_t)item));
+            sep = ",";
+        }
+    }
+    client.print("}}");
+    client.stop();
+}
+
+
+// /json/all?boot=id&since=seq&timeout=s: answer at once if items changed after seq, else keep client waiting.
+// A seq of another boot (id differs) is treated as since=0, so the client gets all items again
+void poll_connect() {
+    uint32_t since = web_server.arg("since").toInt();
+    if (web_server.hasArg("boot") && strtoul(web_server.arg("boot").c_str(), NULL, 16) != json_boot) {
+        since = 0;
+    }
+    uint32_t timeout = web_server.hasArg("timeout") ? web_server.arg("timeout").toInt() : 25;
+    if (timeout > 60) {
+        timeout = 60;
+    }
+
+    WiFiClient client = web_server.client();
+    if (since != json_seq || timeout == 0) {
+        poll_reply(client, since);
+        return;
+    }
+    for (auto &poll: poll_clients) {
+        if (!poll.client.connected()) {
+            poll.client = client;
+            poll.since = since;
+            poll.start = millis();
+            poll.timeout = timeout * 1000;
+            return;
+        }
+    }
+    web_server.send(503, "text/plain", "Too many poll clients");
+}
+
+
+// Answer waiting clients if items changed or timeout expired
+void handle_polls() {
+    uint32_t now = millis();
+    for (auto &poll: poll_clients) {
+        if (poll.client.connected()) {
+            if (json_seq != poll.since || now - poll.start >= poll.timeout) {
+                poll_reply(poll.client, poll.since);
+            }
+        }
+    }
+}
+
+
+// Collects history records in chunks for the web client
+typedef struct history_ctx {
+    char buf[1024];
+    size_t len;
+    bool first;
+    ESmart3History::resolution_t res;
+} history_ctx_t;
+
+
+void history_flush( history_ctx_t &ctx ) {
+    if( ctx.len ) {
+        web_server.sendContent(ctx.buf, ctx.len);
+        ctx.len = 0;
+    }
+}
+
+
+void history_append( history_ctx_t &ctx, const char *key, const int16_t *values ) {
+    ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, ",\"%s\":[", key);
+    for( size_t i = 0; i < ESmart3History::FIELDS; i++ ) {
+        ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, i ? ",%d" : "%d", values[i]);
+    }
+    ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, "]");
+}
+
+
+void history_record( const ESmart3History::record_t &record, void *arg ) {
+    history_ctx_t &ctx = *(history_ctx_t *)arg;
+    if( sizeof(ctx.buf) - ctx.len < 384 ) {
+        history_flush(ctx);  // one record needs less than 384 bytes
+    }
+    ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, "%s{\"Time\":%u,\"Count\":%u",
+        ctx.first ? "" : ",", record.time, record.count);
+    if( ctx.res == ESmart3History::RAW ) {
+        history_append(ctx, "Values", record.avg);
+    }
+    else {
+        history_append(ctx, "Min", record.min);
+        history_append(ctx, "Max", record.max);
+        history_append(ctx, "Avg", record.avg);
+    }
+    ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, "}");
+    ctx.first = false;
+}
+
+
+// Send ChgSts history as json: /json/History?res=raw|1m|15m|1h&from=<epoch>&to=<epoch>
+void send_history() {
+    history_ctx_t ctx;
+    ctx.len = 0;
+    ctx.first = true;
+    ctx.res = ESmart3History::MIN1;
+    if( web_server.hasArg("res") ) {
+        ctx.res = ESmart3History::resolution(web_server.arg("res").c_str());
+        if( ctx.res == ESmart3History::RESOLUTIONS ) {
+            web_server.send(400, "text/plain", "res must be raw, 1m, 15m or 1h");
+            return;
+        }
+    }
+    uint32_t from = web_server.hasArg("from") ? strtoul(web_server.arg("from").c_str(), NULL, 10) : 0;
+    uint32_t to = web_server.hasArg("to") ? strtoul(web_server.arg("to").c_str(), NULL, 10) : 0xffffffff;
+
+    web_server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    web_server.send(200, "application/json", "");
+
+    ctx.len = snprintf(ctx.buf, sizeof(ctx.buf), "{\"Version\":" VERSION ",\"Serial\":\"%.8s\",\"History\":{"
+        "\"Resolution\":\"%s\",\"Period\":%u,\"Fields\":[", (char *)es3Information.value().wSerial,
+        ESmart3History::name(ctx.res), ESmart3History::period(ctx.res));
+    for( size_t i = 0; i < ESmart3History::FIELDS; i++ ) {
+        ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, "%s\"%s\"", i ? "," : "", ESmart3History::fieldName(i));
+    }
+    ctx.len += snprintf(&ctx.buf[ctx.len], sizeof(ctx.buf) - ctx.len, "],\"Records\":[");
+
+    es3History.query(ctx.res, from, to, history_record, &ctx);
+
+    history_flush(ctx);
+    web_server.sendContent("]}}");
+    web_server.sendContent("");  // end of chunked response
+}
+
+
+// Status page is a static gzip compressed asset with strong ETag, so browsers
+// load it once and revalidate it with a 304 response until a new firmware changes it
+#include "index_html.h"
+
+void send_index() {
+    if (web_server.header("If-None-Match") == INDEX_HTML_ETAG) {
+        web_server.send(304);
+        return;
+    }
+    web_server.sendHeader("ETag", INDEX_HTML_ETAG);
+    web_server.sendHeader("Cache-Control", "no-cache");
+    web_server.sendHeader("Content-Encoding", "gzip");
+    web_server.send_P(200, "text/html", (const char *)index_html_gz, sizeof(index_html_gz));
+}
+
+
+// Dynamic values of the status page
+bool json_Status(char *json, size_t maxlen) {
+    static const char jsonFmt[] =
+        "{\"Version\":" VERSION ",\"Serial\":\"%.8s\",\"Status\":{"
+        "\"Host\":\"%s\","
+        "\"StartTime\":\"%s\","
+        "\"Time\":\"%s\","
+        "\"InfluxTime\":\"%s\","
+        "\"InfluxStatus\":%d,"
+        "\"LoadLatency\":%u,"
+        "\"LoadLatencyMax\":%u,"
+        "\"DutyCycle\":%.1f,"
+        "\"Breathing\":%s}}";
+
+    char curr_time[30], influx_time[30];
     time_t now;
     time(&now);
     strftime(curr_time, sizeof(curr_time), "%FT%T%Z", localtime(&now));
     strftime(influx_time, sizeof(influx_time), "%FT%T%Z", localtime(&post_time));
-    snprintf(page, sizeof(page), fmt, (char *)es3Information.wSerial,
-        (char *)es3Information.wSerial, body, start_time, curr_time,
-        influx_time, influx_status);
-    return page;
+
+    int len = snprintf(json, maxlen, jsonFmt, (char *)es3Information.value().wSerial, WiFi.getHostname(),
+        start_time, curr_time, influx_time, influx_status, load_latency.last, load_latency.max,
+        loop_duty.permille / 10.0,         enabledBreathing ? "true" : "false");
+
+    return len < maxlen;
 }
 
 
 // Define web pages for update, reset or for event infos
 void setup_webserver() {
     web_server.on("/toggle", HTTP_POST, []() {
+        uint32_t requested = millis();
         bool on;
         const char *msg = "Load unknown";
         if (esmart3.getLoad(on)) {
             on = !on;
-            if (esmart3.setLoad(on)) {
+            if (switch_load(on, requested)) {
                 msg = on ? "Load on" : "Load off";
             }
         }
-        web_server.send(200, "text/html", main_page(msg)); 
+        web_server.send(200, "text/plain", msg); 
     });
 
     web_server.on("/on", HTTP_POST, []() {
+        uint32_t requested = millis();
         bool on;
         const char *msg = "Load on";
         if (!esmart3.getLoad(on) || !on) {
-            if (!esmart3.setLoad(true)) {
+            if (!switch_load(true, requested)) {
                 msg = "Load unknown";
             }
         }
-        web_server.send(200, "text/html", main_page(msg)); 
+        web_server.send(200, "text/plain", msg); 
     });
 
     web_server.on("/off", HTTP_POST, []() {
+        uint32_t requested = millis();
         bool on;
         const char *msg = "Load off";
         if (!esmart3.getLoad(on) || on) {
-            if (!esmart3.setLoad(false)) {
+            if (!switch_load(false, requested)) {
                 msg = "Load unknown";
             }
         }
-        web_server.send(200, "text/html", main_page(msg)); 
+        web_server.send(200, "text/plain", msg); 
     });
 
-    web_server.on("/json/Information", []() {
-        json_Information(msg, sizeof(msg), es3Information);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/Information", []() { send_json(J_Information); });
 
-    web_server.on("/json/ChgSts", []() {
-        json_ChgSts(msg, sizeof(msg), es3ChgSts);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/ChgSts", []() { send_json(J_ChgSts); });
 
-    web_server.on("/json/BatParam", []() {
-        json_BatParam(msg, sizeof(msg), es3BatParam);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/Energy", []() { send_json(J_Energy); });
 
-    web_server.on("/json/Log", []() {
-        json_Log(msg, sizeof(msg), es3Log);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/History", send_history);
 
-    web_server.on("/json/Parameters", []() {
-        json_Parameters(msg, sizeof(msg), es3Parameters);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/Events", send_events);
 
-    web_server.on("/json/LoadParam", []() {
-        json_LoadParam(msg, sizeof(msg), es3LoadParam);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/Stats", send_stats);
 
-    web_server.on("/json/ProParam", []() {
-        json_ProParam(msg, sizeof(msg), es3ProParam);
-        web_server.send(200, "application/json", msg);
-    });
+    web_server.on("/json/all", HTTP_GET, poll_connect);
+
+    web_server.on("/events", HTTP_GET, events_connect);
+
+    web_server.on("/json/BatParam", []() { send_json(J_BatParam); });
+
+    web_server.on("/json/Log", []() { send_json(J_Log); });
+
+    web_server.on("/json/Parameters", []() { send_json(J_Parameters); });
+
+    web_server.on("/json/LoadParam", []() { send_json(J_LoadParam); });
+
+    web_server.on("/json/ProParam", []() { send_json(J_ProParam); });
 
     // Call this page to reset the ESP
     web_server.on("/reset", HTTP_POST, []() {
         syslog.log(LOG_NOTICE, "RESET");
-        web_server.send(200, "text/html",
-                        "<html>\n"
-                        " <head>\n"
-                        "  <title>" PROGNAME " v" VERSION "</title>\n"
-                        "  <meta http-equiv=\"refresh\" content=\"7; url=/\"> \n"
-                        " </head>\n"
-                        " <body>Resetting...</body>\n"
-                        "</html>\n");
+        save_es3Energy();
+        web_server.send(200, "text/plain", "Resetting...");
         delay(200);
         ESP.restart();
     });
 
-    // Index page
-    web_server.on("/", []() { 
-        web_server.send(200, "text/html", main_page(""));
+    web_server.on("/json/Status", []() {
+        json_Status(msg, sizeof(msg));
+        web_server.send(200, "application/json", msg);
     });
 
+    // Index page
+    web_server.on("/", HTTP_GET, send_index);
+
     // Toggle breathing status led if you dont like it or ota does not work
     web_server.on("/breathe", HTTP_POST, []() {
         enabledBreathing = !enabledBreathing; 
-        web_server.send(200, "text/html", main_page(enabledBreathing ? "breathing enabled" : "breathing disabled")); 
+        web_server.send(200, "text/plain", enabledBreathing ? "breathing enabled" : "breathing disabled"); 
     });
 
     web_server.on("/breathe", HTTP_GET, []() {
-        web_server.send(200, "text/html", main_page(enabledBreathing ? "breathing enabled" : "breathing disabled")); 
+        web_server.send(200, "text/plain", enabledBreathing ? "breathing enabled" : "breathing disabled"); 
     });
 
     // Catch all page
     web_server.onNotFound( []() { 
-        web_server.send(404, "text/html", main_page("<h2>page not found</h2>\n")); 
+        web_server.send(404, "text/plain", "page not found"); 
     });
 
+    static const char *headers[] = { "If-None-Match" };
+    web_server.collectHeaders(headers, sizeof(headers) / sizeof(*headers));
     web_server.begin();
 
     MDNS.addService("http", "tcp", WEBSERVER_PORT);
@@ -842,6 +1718,10 @@ void handle_load_button( bool loadOn ) {
     static uint32_t debounceStatus = 1;
     static bool pressed = false;
 
+    if( debounceStatus != 0 && debounceStatus != 0xffffffff ) {
+        due(prevTime + 3);  // bouncing, else wait for button interrupt
+    }
+
     uint32_t now = millis();
     if( now - prevTime > 2 ) {  // debounce check every 2 ms, decision after 2ms/bit * 32bit = 64ms
         prevTime = now;
@@ -854,7 +1734,7 @@ void handle_load_button( bool loadOn ) {
         }
         else if( debounceStatus == 0xffffffff && !pressed ) {
             pressed = true;
-            if (esmart3.setLoad(!loadOn)) {
+            if (switch_load(!loadOn, now)) {
                 if( !loadOn ) {
                     Serial.println("Load switched ON");
                 }
@@ -880,6 +1760,8 @@ bool handle_load_led() {
     static bool prevStatus = false;  // status unknown
     static bool prevLoad = true;     // assume load is on
 
+    due(prevTime + 501);
+
     uint32_t now = millis();
     if( now - prevTime > 500 ) {
         prevTime = now;
@@ -912,10 +1794,12 @@ bool handle_load_led() {
 }
 
 
-// check ntp status
+// check ntp status and map sample timestamps to it once a minute
 // return true if time is valid
 bool check_ntptime() {
+    static const uint32_t interval = 60000;
     static bool have_time = false;
+    static uint32_t synced = 0;  // millis() of last clock sync
 
     #if defined(ESP32)
         bool valid_time = time(0) > 1582230020;
@@ -924,6 +1808,31 @@ bool check_ntptime() {
         bool valid_time = ntp.isTimeSet();
     #endif
 
+    if (valid_time && (!es3Clock.valid() || millis() - synced >= interval)) {
+        #if defined(ESP32)
+            struct timeval tv;
+            gettimeofday(&tv, NULL);
+            uint64_t epoch_ms = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        #else
+            // NTPClient has seconds only: sync at the first pass after a second starts
+            static unsigned long prev_sec = 0;
+            unsigned long sec = ntp.getEpochTime();
+            uint64_t epoch_ms = (prev_sec && sec != prev_sec) ? (uint64_t)sec * 1000 : 0;
+            prev_sec = sec;
+        #endif
+        if (epoch_ms) {
+            synced = millis();
+            int32_t step = es3Clock.sync(epoch_ms, synced);
+            if (abs(step) >= 1000) {
+                snprintf(msg, sizeof(msg), "Sample clock stepped by %dms", step);
+                slog(msg, LOG_NOTICE);
+            }
+            #if !defined(ESP32)
+                prev_sec = 0;  // wait for next second edge at next sync
+            #endif
+        }
+    }
+
     if (!have_time && valid_time) {
         have_time = true;
         time_t now = time(NULL);
@@ -947,6 +1856,7 @@ void handle_breathe() {
 
     // map elapsed in breathing intervals
     uint32_t now = millis();
+    due(now + 20);  // smooth animation needs updates at 50Hz
     uint32_t elapsed = now - start;
     if (elapsed > breathe_interval) {
         start = now;
@@ -974,36 +1884,165 @@ void handle_breathe() {
 }
 
 
-void handle_es3Time( bool time_valid ) {
+bool handle_es3Time( bool time_valid ) {
+    static const uint32_t interval = 60000;  // setTime is unreliable: retry once a minute, other polls go on
+    static uint32_t prev = 0 - interval;
     static bool time_set = false;
 
-    if( !time_set && time_valid ) {
-        struct tm now;
-        getLocalTime(&now);  // TODO: ESP32 only?
-        if (esmart3.setTime(now)) {
+    if( time_set || !time_valid ) {
+        return false;
+    }
+    due(prev + interval);
+    uint32_t now = millis();
+    if( now - prev >= interval ) {
+        prev = now;
+        struct tm tm_now;
+        getLocalTime(&tm_now);  // TODO: ESP32 only?
+        if (esmart3.setTime(tm_now)) {
             time_set = true;
             slog("eSmart3 time set", LOG_NOTICE);
         }
+        else {
+            slog("setTime error", LOG_ERR, LC_DEVICE);
+        }
+        return true;
     }
+    return false;
+}
+
+
+// Queued device commands from mqtt, executed by handle_commands() in loop, not in the mqtt callback
+// One slot per parameter item: fields of several messages for the same item are merged into one update
+typedef struct command {
+    const char *name;      // item name as used in set and result topics
+    ESmart3::item_t item;
+    uint32_t mask;         // words to write, 0 if nothing queued
+    uint16_t words[16];    // desired values at item word offsets
+} command_t;
+
+command_t commands[] = {
+    { "BatParam", ESmart3::BatParam, 0, {0} },
+    { "ProParam", ESmart3::ProParam, 0, {0} },
+    { "LoadParam", ESmart3::LoadParam, 0, {0} }
+};
+
+int8_t load_command = -1;  // 0: off, 1: on, -1: nothing queued
+uint32_t load_command_ms = 0;  // millis() when load command was queued
+
+
+// Publish result of a command as {"Item":"name","Result":"ok|failed|invalid","Info":"..."}
+void publish_result( const char *name, const char *result, const char *info ) {
+    char topic[64], json[160];
+    snprintf(topic, sizeof(topic), MQTT_TOPIC "/result/%s", name);
+    snprintf(json, sizeof(json), "{\"Item\":\"%s\",\"Result\":\"%s\",\"Info\":\"%s\"}", name, result, info);
+    publish(topic, json);
+    slog(json, strcmp(result, "ok") ? LOG_WARNING : LOG_NOTICE);
 }
 
 
-// Called on incoming mqtt messages
+// Parse "Field=value,..." or a flat json object {"Field":value,...} with raw device values
+// Queue the fields if all are valid writable fields of the item, else publish why not
+void queue_command( command_t &cmd, const char *payload, unsigned int length ) {
+    char buf[256];
+    size_t len = 0;
+    for (unsigned int i = 0; i < length && len < sizeof(buf) - 1; i++) {
+        if (!isspace(payload[i]) && payload[i] != '"') {
+            buf[len++] = payload[i];
+        }
+    }
+    buf[len] = '\0';
+
+    uint16_t words[16];
+    uint32_t mask = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(buf, ",{}", &save); tok; tok = strtok_r(NULL, ",{}", &save)) {
+        char *sep = strpbrk(tok, "=:");
+        if (!sep) {
+            publish_result(cmd.name, "invalid", tok);
+            return;
+        }
+        *sep = '\0';
+        const ESmart3::field_t *field = ESmart3::field(cmd.item, tok);
+        char *end = NULL;
+        long value = strtol(sep + 1, &end, 0);
+        bool in_range = (field && field->type == ESmart3::I16) 
+            ? (value >= INT16_MIN && value <= INT16_MAX) : (value >= 0 && value <= UINT16_MAX);
+        if (!field || field->offset >= 16 || end == sep + 1 || *end || !in_range) {
+            publish_result(cmd.name, "invalid", tok);
+            return;
+        }
+        words[field->offset] = (uint16_t)value;
+        mask |= 1UL << field->offset;
+    }
+
+    if (!mask) {
+        publish_result(cmd.name, "invalid", "no fields");
+        return;
+    }
+
+    for (size_t i = 0; i < 16; i++) {
+        if (mask & (1UL << i)) {
+            cmd.words[i] = words[i];  // newer values of the same field win
+        }
+    }
+    cmd.mask |= mask;
+    due(millis());
+}
+
+
+// Execute one queued command per call. Called first in loop so commands do not wait behind the pollers
+void handle_commands() {
+    if (load_command >= 0) {
+        bool on = load_command;
+        load_command = -1;
+        publish_result("Load", switch_load(on, load_command_ms) ? "ok" : "failed", on ? "on" : "off");
+        due(millis());  // maybe more queued
+        return;
+    }
+
+    for (auto &cmd: commands) {
+        if (cmd.mask) {
+            char info[40];
+            size_t frames = 0;
+            bool ok = esmart3.update(cmd.item, cmd.words, cmd.mask, &frames);
+            snprintf(info, sizeof(info), "mask 0x%04x, %u frames", cmd.mask, (unsigned)frames);
+            cmd.mask = 0;
+            publish_result(cmd.name, ok ? "ok" : "failed", info);
+            due(millis());  // maybe more queued
+            return;
+        }
+    }
+}
+
+
+// Called on incoming mqtt messages: only parse and queue, device access is done in handle_commands()
 void mqtt_callback(char* topic, byte* payload, unsigned int length) {
 
-    typedef struct cmd { const char *name; void (*action)(void); } cmd_t;
+    typedef struct cmd { const char *name; int8_t load; } cmd_t;
     
     static cmd_t cmds[] = { 
-        { "load on", [](){ esmart3.setLoad(true); } },
-        { "load off", [](){ esmart3.setLoad(false); } }
+        { "load on", 1 },
+        { "load off", 0 }
     };
 
     if (strcasecmp(MQTT_TOPIC "/cmd", topic) == 0) {
         for (auto &cmd: cmds) {
             if (strncasecmp(cmd.name, (char *)payload, length) == 0) {
-                snprintf(msg, sizeof(msg), "Execute mqtt command '%s'", cmd.name);
+                snprintf(msg, sizeof(msg), "Queue mqtt command '%s'", cmd.name);
                 slog(msg, LOG_INFO);
-                (*cmd.action)();
+                load_command = cmd.load;
+                load_command_ms = millis();
+                due(load_command_ms);
+                return;
+            }
+        }
+    }
+
+    static const char set_prefix[] = MQTT_TOPIC "/set/";
+    if (strncasecmp(set_prefix, topic, sizeof(set_prefix) - 1) == 0) {
+        for (auto &cmd: commands) {
+            if (strcasecmp(cmd.name, topic + sizeof(set_prefix) - 1) == 0) {
+                queue_command(cmd, (const char *)payload, length);
                 return;
             }
         }
@@ -1014,14 +2053,47 @@ void mqtt_callback(char* topic, byte* payload, unsigned int length) {
 }
 
 
+// Send retained home assistant discovery config for each ChgSts field topic
+bool publish_discovery() {
+    static const char cfgFmt[] =
+        "{\"name\":\"%s\",\"uniq_id\":\"esmart3_%.8s_%s\","
+        "\"stat_t\":\"" MQTT_TOPIC "/ChgSts/%s\","
+        "\"avty_t\":\"" MQTT_TOPIC "/status/LWT\",\"pl_avail\":\"Online\",\"pl_not_avail\":\"Offline\",%s"
+        "\"dev\":{\"ids\":\"esmart3_%.8s\",\"name\":\"%s\",\"mdl\":\"eSmart3\",\"sw\":\"" VERSION "\"}}";
+
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    for (size_t i = 0; i < count && i < MQTT_FIELDS; i++) {
+        char topic[96], extra[96] = "";
+        const mqtt_field_t &field = mqtt_fields[i];
+        if (field.unit) {
+            snprintf(extra, sizeof(extra), "\"unit_of_meas\":\"%s\",\"dev_cla\":\"%s\",\"stat_cla\":\"measurement\",", 
+                field.unit, field.cls);
+        }
+        snprintf(topic, sizeof(topic), MQTT_DISCOVERY "/sensor/esmart3_%.8s/%s/config", 
+            (char *)es3Information.value().wSerial, fields[i].name);
+        snprintf(msg, sizeof(msg), cfgFmt, fields[i].name, (char *)es3Information.value().wSerial, fields[i].name, 
+            fields[i].name, extra, (char *)es3Information.value().wSerial, HOSTNAME);
+        if (!mqtt.publish(topic, msg, true)) {
+            slog("Mqtt discovery failed", LOG_ERR, LC_NET);
+            return false;
+        }
+    }
+    return true;
+}
+
 void handle_mqtt( bool time_valid ) {
     static const int32_t interval = 5000;  // if disconnected try reconnect this often in ms
     static uint32_t prev = -interval;      // first connect attempt without delay
 
     if (mqtt.connected()) {
         mqtt.loop();
+        if (!mqtt_discovered && es3Information.value().wSerial[0]) {
+            mqtt_discovered = publish_discovery();
+        }
     }
     else {
+        due(prev + interval + 1);
         uint32_t now = millis();
         if (now - prev > interval) {
             if (mqtt.connect(HOSTNAME, mqtt_user, mqtt_pass, MQTT_TOPIC "/status/LWT", 0, true, "Offline")
@@ -1032,9 +2104,12 @@ void handle_mqtt( bool time_valid ) {
              && mqtt.publish(MQTT_TOPIC "/status/DBName", INFLUX_DB)
              && mqtt.publish(MQTT_TOPIC "/status/Version", VERSION)
              && (!time_valid || mqtt.publish(MQTT_TOPIC "/status/StartTime", start_time))
-             && mqtt.subscribe(MQTT_TOPIC "/cmd")) {
+             && mqtt.subscribe(MQTT_TOPIC "/cmd")
+             && mqtt.subscribe(MQTT_TOPIC "/set/+")) {
                 snprintf(msg, sizeof(msg), "Connected to MQTT broker %s:%d using topic %s", MQTT_SERVER, MQTT_PORT, MQTT_TOPIC);
                 slog(msg, LOG_NOTICE);
+                mqtt_valid = false;  // broker might have missed changes
+                mqtt_discovered = false;
             }
             else {
                 int error = mqtt.state();
@@ -1048,6 +2123,39 @@ void handle_mqtt( bool time_valid ) {
  }
 
 
+// Setup power saving while waiting
+void setup_duty() {
+    #if defined(ESP32)
+        loop_task = xTaskGetCurrentTaskHandle();
+        attachInterrupt(digitalPinToInterrupt(LOAD_BUTTON_PIN), wakeup, FALLING);
+
+        // Light sleep in idle task needs power management. Only UART0 and UART1 can wake the
+        // chip, not the rs485 Serial2: a lock keeps the cpu awake during loop passes, so
+        // every command and its reply happen awake and only waiting for due work may sleep.
+        // No gpio wakeup for the button: it would switch its pin to a level interrupt and the
+        // wakeup ISR would fire continuously while the button is held. Light sleep never lasts
+        // longer than LOOP_MAX_WAIT, so the button is sampled well within its 64ms debounce time
+        esp_err_t rc = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "loop", &awake_lock);
+        if (rc != ESP_OK || (rc = esp_pm_lock_acquire(awake_lock)) != ESP_OK) {
+            snprintf(msg, sizeof(msg), "No awake lock (error %d), no automatic light sleep", rc);
+            slog(msg, LOG_NOTICE);
+            awake_lock = NULL;
+        }
+        else {
+            esp_pm_config_esp32_t pm = { 240, 80, true };
+            if ((rc = esp_pm_configure(&pm)) != ESP_OK) {
+                snprintf(msg, sizeof(msg), "No automatic light sleep (error %d), only waiting", rc);
+                slog(msg, LOG_NOTICE);
+            }
+        }
+        WiFi.setSleep(true);  // modem sleep, required for light sleep with WiFi
+    #elif defined(ESP8266)
+        WiFi.setSleepMode(WIFI_LIGHT_SLEEP);  // light sleep during delay()
+    #endif
+    loop_duty.window = micros();
+}
+
+
 // Startup
 void setup() {
     WiFi.mode(WIFI_STA);
@@ -1104,6 +2212,7 @@ void setup() {
 
     mqtt.setServer(MQTT_SERVER, MQTT_PORT);
     mqtt.setCallback(mqtt_callback);
+    mqtt.setBufferSize(768);  // item json and discovery configs exceed the default 256 bytes
     #ifdef MQTT_USER
     if( MQTT_USER[0] ) mqtt_user = MQTT_USER;
     #endif
@@ -1129,6 +2238,23 @@ void setup() {
 
     esmart3.begin(RS485_DIR_PIN);
 
+    #if defined(ESP32)
+        prefs.begin(PROGNAME);
+    #endif
+    for (auto &cache: json_cache) {
+        cache.rendered = UINT32_MAX;  // nothing rendered yet: first use renders, also before the first change
+    }
+    load_es3Energy();
+    load_es3Cache();
+
+    json_boot = random(0x7fffffff);
+
+    if (!es3History.begin()) {
+        slog("History buffers incomplete", LOG_WARNING);
+    }
+
+    setup_duty();
+
     Serial.println("Setup done");
 }
 
@@ -1136,22 +2262,40 @@ void setup() {
 // Main loop
 void loop() {
     // TODO set/reset err_interval for breathing
-    handle_es3Information();
+    uint32_t pass_start = micros();
+
+    // Control first: load button, web requests (e.g. /off) and queued mqtt commands
+    handle_load_button(handle_load_led());
+    web_server.handleClient();
+    handle_commands();
+
+    // At most one poll transaction per pass, so control waits for one transaction only.
+    // Handlers after a transaction are skipped: next pass comes at once, so they run or report when they are due
+    bool polled = handle_es3Information();
     bool have_time = check_ntptime();
-    if( es3Information.wSerial[0] ) {  // we have required esmart3 infos
+    if( es3Information.value().wSerial[0] ) {  // we have required esmart3 infos
         if (have_time && enabledBreathing) {
             handle_breathe();
         }
-        handle_es3Time(have_time);
-        handle_es3ChgSts();
-        handle_es3BatParam();
-        handle_es3Log();
-        handle_es3Parameters();
-        handle_es3ProParam();
-        handle_es3LoadParam();
-        // ignoring TempParam and EngSave (for now?)
+        if( !polled ) {
+            polled = handle_es3Time(have_time)
+                || handle_es3ChgSts(have_time)
+                || handle_es3BatParam()
+                || handle_es3Log()
+                || handle_es3Parameters()
+                || handle_es3ProParam()
+                || handle_es3LoadParam();
+            // ignoring TempParam and EngSave (for now?)
+        }
+        handle_es3Energy();
+        handle_es3Stats();
     }
-    handle_load_button(handle_load_led());
-    web_server.handleClient();
+    if( polled ) {
+        due(millis());  // skipped handlers did not report their deadline
+    }
+    handle_events();
+    handle_polls();
+    handle_log();
     handle_mqtt(have_time);
+    handle_duty(pass_start);
 }
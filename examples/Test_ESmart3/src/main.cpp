@@ -217,12 +217,17 @@ void loop() {
         }
 
         ESmart3::EngSave_t eng = {0};
-        if( esmart3.getEngSave(eng, 0x19, 0x31) ) {
+        if( esmart3.getEngSave(eng) ) {  // 348 bytes, read in 3 chunks
             Serial.print("getEngSave MonthLoadPower "); 
             for( size_t i = 0; i < 11; i++ ) {
                 Serial.printf("month %u: %d Wh, ", i+1, eng.wMonthLoadPower[i]);
             } 
             Serial.printf("month 12: %d Wh\n", eng.wMonthLoadPower[11]);
+            Serial.print("getEngSave DayPower "); 
+            for( size_t i = 0; i < 30; i++ ) {
+                Serial.printf("day %u: %d Wh, ", i+1, eng.wDayPower[i]);
+            } 
+            Serial.printf("day 31: %d Wh\n", eng.wDayPower[30]);
         }
         else {
             Serial.println("getEngSave error");
@@ -8,6 +8,7 @@ The device organizes data in item groups.
 Groups can be read with GET command and written with SET command
 The device answers with ACK (ok) or NACK (error)
 Groups can be read and written as a whole or in parts definded by [start, end[ word offsets
+Ranges larger than one frame (120 bytes, e.g. EngSave_t) are split into back-to-back chunks by the lib
 The 1-byte crc of the device is handled internally by the lib, as well as lengths and offsets in the data region. 
 Except for the basic execute method the command header is also maintained by the lib.
 The execute method is only needed for functions not implemented by higher level get/set-methods
@@ -242,13 +243,25 @@ public:
     // Init serial interface. Set dir_pin to -1 if RS485 hardware sets direction automatically
     void begin( int dir_pin = -1 );
 
+    // Delay in ms between end of last and start of next command (e.g. to restore a known good value at boot)
+    uint8_t commandDelay() const { return _delay; }
+    void setCommandDelay( uint8_t ms ) { _delay = ms; }
+
+    // millis() when the header of the last valid reply arrived (closest to the sampling time of the device)
+    uint32_t rxMillis() const { return _rx; }
+
+    // Max data bytes of a reply: frame length limit 120 minus 2 offset bytes
+    static const size_t MAX_RESULT = 120 - 2;
+
     // Send header and command then receive header and result (not including offset or crc)
     // Return true if header and command are written and result and header are read successfully
-    bool execute( header_t &header, uint8_t *command, uint8_t *result );
+    // Replies with more data than capacity bytes (0 if result is NULL) are rejected before anything is stored
+    bool execute( header_t &header, uint8_t *command, uint8_t *result, size_t capacity = MAX_RESULT );
 
 
     // Get-Commands. If [start, end[ is given (in 16bit offset steps from manual), only relevant part of data is used
-    // Return true if execute() was successful
+    // Return true if execute() was successful for all chunks and the device sent the requested length
+    // Return false without any bus transaction if the range is empty or exceeds the structure
 
     bool getChgSts( ChgSts_t &data, size_t start = 0, size_t end = sizeof(ChgSts_t) / 2 );
     bool getBatParam( BatParam_t &data, size_t start = 0, size_t end = sizeof(BatParam_t) / 2 );
@@ -275,6 +288,20 @@ public:
     ///  LoadOvp: 16V, LoadUvp: 10,5V, BatOvp: 16V, BatOvB 15V, BatUvp: 10,5V, BatUvB (Recov): 11V
     bool setProParam( ProParam_t &data, size_t start = 1, size_t end = sizeof(ProParam_t) / 2 - 1 );
 
+    // Update-Commands: like set, but only words in [start, end[ that differ from the device are written.
+    // Current values are read first, changed words are grouped into as few SET frames as possible
+    // and afterwards the written span is read back to verify the device stored the values.
+    // If frames is not NULL it receives the number of SET frames sent (0 if nothing changed)
+    // Return true if the device holds the given values in [start, end[
+    bool updateBatParam( BatParam_t &data, size_t start = 1, size_t end = sizeof(BatParam_t) / 2 - 2, size_t *frames = 0 );
+    bool updateProParam( ProParam_t &data, size_t start = 1, size_t end = sizeof(ProParam_t) / 2 - 1, size_t *frames = 0 );
+    // Default range covers LoadOnPvVolt to MonLoadOffTime (excludes load switch and status words)
+    bool updateLoadParam( LoadParam_t &data, size_t start = 3, size_t end = 0x0f, size_t *frames = 0 );
+    // Generic variant: only words marked in mask (bit n for word n, items up to 32 words) are checked and written.
+    // Return false without writing if mask marks words beyond the item structure
+    //   words: start of item structure with the desired values
+    bool update( item_t item, const uint16_t *words, uint32_t mask, size_t *frames = 0 );
+
     bool setMaxChargeCurrent( uint16_t deciAmps );
     bool setMaxLoadCurrent( uint16_t deciAmps );
     bool setBacklightTime( uint16_t sec );
@@ -297,17 +324,44 @@ public:
     static bool isTripZeroProtectionTrigger( uint16_t fault ) { return fault & 0x100; };
     static bool isControlByManualSwitchgear( uint16_t fault ) { return fault & 0x200; };
 
+
+    // Generic field access, e.g. for publishing, history or statistics
+
+    typedef enum fieldType { U16, I16, U32 } fieldType_t;
+
+    typedef struct field {
+        const char *name;  // as used in json and influx lines (without w/dw prefix)
+        uint8_t offset;    // word offset in item structure
+        fieldType_t type;
+    } field_t;
+
+    // Return field table of item and its length in count or NULL
+    // ChgSts has all fields, BatParam, ProParam and LoadParam only the writable ones
+    static const field_t *fields( item_t item, size_t &count );
+
+    // Return field of item with name or NULL
+    static const field_t *field( item_t item, const char *name );
+
+    // Return value of field in item structure data
+    static int32_t value( const void *data, const field_t &field );
+
 private:
+    bool getRange( item_t item, uint8_t *data, size_t start, size_t end, size_t limit );
+    bool setRange( item_t item, const uint8_t *data, size_t start, size_t end );
+    static uint32_t rangeMask( size_t start, size_t end );
+    static size_t itemWords( item_t item );
+
     uint8_t genCrc( header_t &header, uint8_t *offset, uint8_t *data );
     bool isValid( header_t &header, uint8_t *offset, uint8_t *data, uint8_t crc );
     bool prepareCmd( header_t &header, uint8_t *command, uint8_t &crc );
     uint8_t *initGetOffset( uint8_t *cmd, uint8_t *data, size_t start, size_t end );
-    void initSetOffset( uint8_t *cmd, uint8_t *data, size_t start, size_t end );
+    void initSetOffset( uint8_t *cmd, const uint8_t *data, size_t start, size_t end );
 
     Stream &_serial;
     uint8_t _delay;
-    uint32_t _prev_local;
+    uint32_t _prev_local;  // used if _prev is NULL. Never via pointer: pack(2) may misalign it
     uint32_t *_prev;
+    uint32_t _rx;
     int _dir_pin;
 };
 
@@ -0,0 +1,108 @@
+#ifndef ESMART3_BUS
+#define ESMART3_BUS
+
+/*
+Optional bus owner task for ESmart3 devices (ESP32 only, uses FreeRTOS)
+
+RS485 is half duplex and the device answers one command at a time.
+If several tasks (web server, mqtt callback, button handler, pollers) use the same
+ESmart3 object, their frames can interleave and corrupt each other.
+ESmart3Bus owns the ESmart3 object in one task pinned to a core and executes
+all transactions in the order they are submitted to its queue.
+Other tasks either wait for the result (call) or get notified by a callback (submit).
+
+Jobs have a priority. URGENT jobs (e.g. load switching) are taken before all waiting
+NORMAL jobs (e.g. polls), so they only wait for the job in progress.
+The time from queueing to completion is measured per priority (latency).
+
+Usage:
+    ESmart3 esmart3(Serial2);
+    ESmart3Bus bus(esmart3);
+
+    bool loadOn( ESmart3 &dev, void *arg ) { return dev.setLoad(true); }
+
+    setup() { ...; esmart3.begin(22); bus.begin(); }
+    anywhere() { if( bus.call(loadOn, 0, portMAX_DELAY, ESmart3Bus::URGENT) ) ... }
+
+Notes:
+* Jobs run in bus task context: they should only talk to the device and copy results.
+* Default core 1 keeps the bus away from WiFi and lwIP on core 0.
+* Before begin() (or if called from a job) call() executes the job directly.
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+#if defined(ESP32)
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+class ESmart3Bus {
+public:
+    // Job to execute in bus task context. Return true on success
+    typedef bool (*job_t)( ESmart3 &esmart3, void *arg );
+    // Called in bus task context after a submitted job is done. Keep it short
+    typedef void (*done_t)( bool rc, void *arg );
+
+    typedef enum priority { NORMAL, URGENT, PRIORITIES } priority_t;
+
+    // Time from queueing to end of job in microseconds
+    typedef struct latency {
+        uint32_t last;
+        uint32_t max;
+        uint32_t count;  // jobs measured
+    } latency_t;
+
+    // Bus task uses esmart3 exclusively and queues up to queue_len pending jobs per priority
+    ESmart3Bus( ESmart3 &esmart3, size_t queue_len = 8 );
+
+    // Create queue and start bus task pinned to core
+    // Return true if task is running
+    bool begin( BaseType_t core = 1, UBaseType_t priority = 3, uint32_t stack_size = 3072 );
+
+    // Queue job and return immediately. If done is not NULL it is called with the job result
+    // Return false if the queue stays full for wait ticks
+    bool submit( job_t job, void *arg, done_t done = 0, TickType_t wait = 0, priority_t prio = NORMAL );
+
+    // Queue job and wait until it is executed. wait only limits the time until the job is queued
+    // Return result of job or false if it could not be queued
+    bool call( job_t job, void *arg, TickType_t wait = portMAX_DELAY, priority_t prio = NORMAL );
+
+    // Statistics
+    uint32_t executed() const { return _executed; }  // jobs done since begin()
+    uint32_t rejected() const { return _rejected; }  // jobs not queued because queue was full
+    size_t pending() const;                          // jobs waiting in queues
+    const latency_t &latency( priority_t prio ) const { return _latency[prio < PRIORITIES ? prio : NORMAL]; }
+
+private:
+    typedef struct request {
+        job_t job;
+        void *arg;
+        done_t done;
+        SemaphoreHandle_t sem;  // given after job is done (synchronous call)
+        bool *rc;               // receives job result (synchronous call)
+        int64_t queued;         // esp_timer_get_time() when queued
+    } request_t;
+
+    static void task( void *self );
+    void run();
+    bool enqueue( request_t &req, TickType_t wait, priority_t prio );
+
+    ESmart3 &_esmart3;
+    size_t _queue_len;
+    QueueHandle_t _queue[PRIORITIES];
+    SemaphoreHandle_t _work;  // counts queued jobs of all priorities
+    TaskHandle_t _task;
+    volatile uint32_t _executed;
+    volatile uint32_t _rejected;
+    latency_t _latency[PRIORITIES];
+};
+
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef ESMART3_CACHE
+#define ESMART3_CACHE
+
+/*
+Cache of eSmart3 device identity and parameters for a fast boot
+
+Information and the parameter items rarely change. Feed every successful read to update()
+and persist state() when update() reports a change (e.g. NVS on ESP32, a file on Linux).
+After a reboot, restore() the saved state and validate() it with one short read of the serial number
+(4 words instead of reading all items). If the same device is connected, the cached items
+can be published at once while regular polling catches up.
+The command delay is cached as well, so a tuned value is used from the first transaction.
+
+Usage:
+    ESmart3Cache cache;
+    if( load(state) && cache.restore(state) && cache.validate(esmart3) && cache.get(data) ) publish(data);
+    if( esmart3.getBatParam(data) && cache.update(data) ) save(cache.state());
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Cache {
+public:
+    // Persistent part of the cache
+    typedef struct state {
+        uint32_t magic;          // STATE_MAGIC if valid
+        uint16_t size;           // sizeof(state_t)
+        uint16_t items;          // bit (1 << item_t) set for each cached item
+        uint8_t commandDelay;    // ms, 0: not cached
+        uint8_t reserved[3];
+        ESmart3::Information_t information;
+        ESmart3::BatParam_t batParam;
+        ESmart3::Parameters_t parameters;
+        ESmart3::LoadParam_t loadParam;
+        ESmart3::ProParam_t proParam;
+        uint32_t check;          // FNV-1a of the bytes before
+    } state_t;
+
+    static const uint32_t STATE_MAGIC = 0xe5e3c001;
+
+    ESmart3Cache();
+
+    // Remember data of a successful read. Return true if the cached state changed (persist it then).
+    // Information of another device drops all cached parameters
+    bool update( const ESmart3::Information_t &data );
+    bool update( const ESmart3::BatParam_t &data );
+    bool update( const ESmart3::Parameters_t &data );
+    bool update( const ESmart3::LoadParam_t &data );
+    bool update( const ESmart3::ProParam_t &data );
+    bool setCommandDelay( uint8_t ms );
+
+    // For persisting and restoring. Return false if state is not valid (cache stays empty)
+    const state_t &state() const { return _state; }
+    bool restore( const state_t &state );
+
+    // Apply cached command delay and read serial number of the device.
+    // Return true if restored cache belongs to it. If another device answers the cache is cleared,
+    // on bus errors it is kept for the next try
+    bool validate( ESmart3 &esmart3 );
+
+    // True if item is cached and belongs to the connected device (validated or updated since restore)
+    bool has( ESmart3::item_t item ) const;
+
+    // Copy cached item into data. Return false if it is not cached for the connected device (see has())
+    bool get( ESmart3::Information_t &data ) const { return copy(ESmart3::Information, &data, &_state.information, sizeof(data)); }
+    bool get( ESmart3::BatParam_t &data ) const { return copy(ESmart3::BatParam, &data, &_state.batParam, sizeof(data)); }
+    bool get( ESmart3::Parameters_t &data ) const { return copy(ESmart3::Parameters, &data, &_state.parameters, sizeof(data)); }
+    bool get( ESmart3::LoadParam_t &data ) const { return copy(ESmart3::LoadParam, &data, &_state.loadParam, sizeof(data)); }
+    bool get( ESmart3::ProParam_t &data ) const { return copy(ESmart3::ProParam, &data, &_state.proParam, sizeof(data)); }
+
+    // Forget everything
+    void clear();
+
+private:
+    bool store( ESmart3::item_t item, void *cached, const void *data, size_t size );
+    bool copy( ESmart3::item_t item, void *data, const void *cached, size_t size ) const;
+    static uint32_t fnv( const void *data, size_t size );
+
+    bool _valid;  // cached items belong to the connected device
+    state_t _state;
+};
+
+#endif
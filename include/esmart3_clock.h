@@ -0,0 +1,52 @@
+#ifndef ESMART3_CLOCK
+#define ESMART3_CLOCK
+
+/*
+Mapping of millis() timestamps to wall clock time in ms since epoch
+
+Samples are stamped with millis() when their reply frame arrives (ESmart3::rxMillis()).
+millis() is monotonic and cheap, but has no date. ESmart3Clock keeps the offset to the
+wall clock from the last sync(), e.g. whenever NTP time is known, so sample timestamps can be
+converted to wall clock ms later, even if the sample was queued, batched or sent after a resync.
+Conversion is valid for samples within 24 days before or after the last sync.
+
+Usage:
+    ESmart3Clock clock;
+    if( ntp_valid ) clock.sync(ntp_epoch_ms);
+    if( esmart3.getChgSts(data) ) post(data, clock.epochMs(esmart3.rxMillis()));
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+// same layout whether or not esmart3.h (which packs everything after its structures) was included first
+#pragma pack(push)
+#pragma pack()
+
+class ESmart3Clock {
+public:
+    ESmart3Clock();
+
+    // Wall clock was epoch_ms at millis() now_ms.
+    // Return step in ms of the wall clock against the previous mapping (0 on first sync)
+    int32_t sync( uint64_t epoch_ms, uint32_t now_ms );
+    int32_t sync( uint64_t epoch_ms ) { return sync(epoch_ms, millis()); }
+
+    // True after first sync()
+    bool valid() const { return _valid; }
+
+    // Wall clock ms since epoch at millis() ms, 0 if not synced yet
+    uint64_t epochMs( uint32_t ms ) const;
+    uint64_t epochMs() const { return epochMs(millis()); }
+
+private:
+    bool _valid;
+    uint64_t _epoch_ms;  // wall clock at last sync
+    uint32_t _sync_ms;   // millis() at last sync
+};
+
+#pragma pack(pop)
+
+#endif
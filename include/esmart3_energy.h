@@ -0,0 +1,80 @@
+#ifndef ESMART3_ENERGY
+#define ESMART3_ENERGY
+
+/*
+Energy and charge counters integrated from eSmart3 ChgSts samples
+
+The device only reports energy in whole Wh or kWh steps (Log_t) and only some of them.
+ESmart3Energy integrates wChgPower/wLoadPower and wChgCurr/wLoadCurr of every sample
+(trapezoidal rule over the time between two samples) with milli resolution.
+Intervals longer than max_gap_ms are not integrated (device or bus was unavailable),
+they are only counted, so outages do not produce made up energy.
+
+Counters can be saved with state() and restored after a reboot with restore().
+
+Usage:
+    ESmart3Energy energy;
+    if( esmart3.getChgSts(data) ) energy.update(data);
+    Serial.printf("PV today: %.3f Wh\n", energy.chargeWh());
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Energy {
+public:
+    // Persistent part of the counters. Integrals are in 2 * unit * ms (trapezoid sums)
+    typedef struct state {
+        uint32_t magic;          // STATE_MAGIC if valid
+        uint32_t gaps;           // intervals not integrated
+        uint64_t chgPower;       // 2 * W * ms
+        uint64_t loadPower;      // 2 * W * ms
+        uint64_t chgCurr;        // 2 * dA * ms
+        uint64_t loadCurr;       // 2 * dA * ms
+        uint64_t time;           // ms integrated
+    } state_t;
+
+    static const uint32_t STATE_MAGIC = 0xe5e30001;
+
+    ESmart3Energy( uint32_t max_gap_ms = 5000 );
+
+    // Integrate interval since previous sample. Call with every successfully read sample
+    void update( const ESmart3::ChgSts_t &data, uint32_t now_ms );
+    void update( const ESmart3::ChgSts_t &data ) { update(data, millis()); }
+
+    // Forget previous sample, e.g. after a device change (counters stay)
+    void restart() { _valid = false; }
+
+    // Set all counters to 0
+    void reset();
+
+    // Counters for persisting and restoring. Return false if state is not valid
+    const state_t &state() const { return _state; }
+    bool restore( const state_t &state );
+
+    // Counters in milli units since reset
+    uint64_t chargeMilliWh() const { return _state.chgPower / (2 * 3600); }
+    uint64_t loadMilliWh() const   { return _state.loadPower / (2 * 3600); }
+    uint64_t chargeMilliAh() const { return _state.chgCurr / (2 * 10 * 3600); }
+    uint64_t loadMilliAh() const   { return _state.loadCurr / (2 * 10 * 3600); }
+
+    // Counters in base units since reset
+    double chargeWh() const { return _state.chgPower / (2 * 3600.0 * 1000); }
+    double loadWh() const   { return _state.loadPower / (2 * 3600.0 * 1000); }
+    double chargeAh() const { return _state.chgCurr / (2 * 10 * 3600.0 * 1000); }
+    double loadAh() const   { return _state.loadCurr / (2 * 10 * 3600.0 * 1000); }
+
+    uint32_t gaps() const { return _state.gaps; }  // intervals not integrated
+    uint64_t integratedMs() const { return _state.time; }
+
+private:
+    uint32_t _max_gap;
+    bool _valid;  // _prev holds a sample
+    uint32_t _prev_ms;
+    ESmart3::ChgSts_t _prev;
+    state_t _state;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef ESMART3_EVENTS
+#define ESMART3_EVENTS
+
+/*
+Raise and clear events of eSmart3 fault and system reminder bits
+
+Feed every ChgSts sample to update(). Each bit of wFault and wSystemReminder
+is debounced: a new bit state counts only after it was seen in debounce
+consecutive samples, so a single glitch on the bus or a flickering alarm
+does not produce events. Bits already set in the first sample are reported
+as raised at once. Each debounced change is stored as timestamped event
+in a fixed size ring buffer (oldest events are overwritten).
+
+Events are numbered from 0 on. Consumers remember the next number they want and
+fetch everything newer with event(), so transitions are never reported twice
+and steady states cost nothing.
+
+Usage:
+    ESmart3Events events;
+    uint32_t next = 0;
+    if( esmart3.getChgSts(data) && events.update(data, time(NULL)) ) {
+        ESmart3Events::event_t e;
+        while( events.event(next, e) ) { next++; print(e); }
+    }
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Events {
+public:
+    enum { LOG_SIZE = 32 };  // events kept
+
+    typedef enum source { FAULT, REMINDER } source_t;
+
+    typedef struct event {
+        uint32_t time;    // as given to update()
+        uint8_t source;   // source_t
+        uint8_t bit;      // bit number in wFault or wSystemReminder
+        uint8_t raised;   // 1 if bit got set, 0 if cleared
+    } event_t;
+
+    // A bit change is accepted after debounce equal samples (1: immediately)
+    ESmart3Events( uint8_t debounce = 2 );
+
+    // Check sample for bit changes. Return number of new events
+    size_t update( const ESmart3::ChgSts_t &data, uint32_t time );
+
+    // Debounced bits
+    uint16_t fault() const { return _state[FAULT]; }
+    uint16_t reminder() const { return _state[REMINDER]; }
+
+    // Number of the next event (= number of events since construction)
+    uint32_t next() const { return _next; }
+
+    // Copy event with number n. Return false if it is not yet there or already overwritten
+    bool event( uint32_t n, event_t &e ) const;
+
+    // Name of a bit (e.g. "BatteryVoltageOver") or NULL if unknown
+    static const char *name( source_t source, uint8_t bit );
+
+private:
+    void add( source_t source, uint8_t bit, bool raised, uint32_t time );
+
+    uint8_t _debounce;
+    bool _valid;  // _state holds a debounced sample
+    uint16_t _state[2];      // debounced bits
+    uint8_t _count[2][16];   // consecutive samples with bit differing from state
+    uint32_t _next;
+    event_t _log[LOG_SIZE];
+};
+
+#endif
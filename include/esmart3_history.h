@@ -0,0 +1,106 @@
+#ifndef ESMART3_HISTORY
+#define ESMART3_HISTORY
+
+/*
+Fixed memory history of eSmart3 ChgSts samples at several resolutions
+
+Keeps the numeric ChgSts fields (PvVolt to BatCap) in ring buffers:
+* RAW: every sample with its timestamp
+* MIN1, MIN15, HOUR1: min, max and average of all samples within each period
+Memory is allocated once in begin() (in PSRAM if available and wanted) and never grows.
+Aggregate slots carry no timestamp (it follows from the slot position) and values are
+packed 16-bit, so a week of hourly data takes about 11kB with default sizes.
+
+Times are in seconds (e.g. time(NULL)). Samples older than the newest one are ignored.
+
+Usage:
+    ESmart3History history;
+    setup() { history.begin(); }
+    if( esmart3.getChgSts(data) ) history.add(data, time(NULL));
+    history.query(ESmart3History::MIN15, from, to, print_record, 0);
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3History {
+public:
+    enum { FIELDS = 11 };  // ChgSts fields PvVolt to BatCap
+
+    typedef enum resolution { RAW, MIN1, MIN15, HOUR1, RESOLUTIONS } resolution_t;
+
+    // Query result. For RAW records count is 1 and min, max and avg are the sample values
+    typedef struct record {
+        uint32_t time;  // sample time or start of period
+        uint16_t count;  // samples in period
+        int16_t min[FIELDS];
+        int16_t max[FIELDS];
+        int16_t avg[FIELDS];
+    } record_t;
+
+    // Called by query() for each record in range
+    typedef void (*visit_t)( const record_t &record, void *arg );
+
+    // Number of records kept per resolution. Defaults: 2 min raw, 2 h by minute, 1 day by 15 min, 1 week by hour
+    ESmart3History( size_t raw = 240, size_t min1 = 120, size_t min15 = 96, size_t hour1 = 168 );
+    ~ESmart3History();
+
+    // Allocate buffers, prefer PSRAM on ESP32 if psram is true
+    // Return true if all buffers are available
+    bool begin( bool psram = true );
+
+    // Add sample taken at time (seconds)
+    void add( const ESmart3::ChgSts_t &data, uint32_t time );
+
+    // Call visit for all records of resolution with time in [from, to[, oldest first
+    // Return number of visited records
+    size_t query( resolution_t res, uint32_t from, uint32_t to, visit_t visit, void *arg ) const;
+
+    // Return period of resolution in seconds (0 for RAW)
+    static uint32_t period( resolution_t res );
+
+    // Return name of resolution ("raw", "1m", "15m", "1h") and parse it back (RESOLUTIONS if unknown)
+    static const char *name( resolution_t res );
+    static resolution_t resolution( const char *name );
+
+    // Return name of history field index
+    static const char *fieldName( size_t index );
+
+    // Memory used by all buffers in bytes
+    size_t memory() const;
+
+private:
+    typedef struct sample {
+        uint32_t time;
+        int16_t value[FIELDS];
+    } sample_t;
+
+    typedef struct slot {
+        uint16_t count;
+        int16_t min[FIELDS];
+        int16_t max[FIELDS];
+        int16_t avg[FIELDS];
+    } slot_t;
+
+    typedef struct tier {
+        slot_t *slots;
+        size_t size;
+        size_t newest;  // index of newest slot
+        size_t used;
+        uint32_t time;  // start of newest slot period
+        int32_t sum[FIELDS];  // sum of newest slot samples
+    } tier_t;
+
+    static void *alloc( size_t size, bool psram );
+    void addTier( tier_t &tier, uint32_t period, const int16_t *value, uint32_t time );
+
+    sample_t *_raw;
+    size_t _rawSize;
+    size_t _rawNewest;
+    size_t _rawUsed;
+    tier_t _tier[RESOLUTIONS - 1];  // MIN1 to HOUR1
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef ESMART3_PROFILE
+#define ESMART3_PROFILE
+
+/*
+Desired state of eSmart3 parameters with drift detection
+
+Holds wanted BatParam, ProParam and LoadParam values and the words of each item to enforce.
+Settings can change behind our back (front panel, controller reset, other tools).
+Calling handle() regularly checks one item at a time, round robin:
+only the span of enforced words is read (one short GET frame) and only differing
+words are written back and verified (see ESmart3::update()).
+So enforcing a profile costs a small, bounded share of bus time.
+
+Usage:
+    ESmart3Profile profile(esmart3);
+    setup() { ...; profile.setBatParam(batParam); }
+    loop() { profile.handle(60000); }  // check every item once a minute
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Profile {
+public:
+    // Default words to enforce (bit n for word n)
+    static const uint32_t BAT_PARAM_MASK = 0x000001fe;   // BatType to EqualizeChgTime
+    static const uint32_t PRO_PARAM_MASK = 0x0000007e;   // LoadOvp to BatUvB
+    static const uint32_t LOAD_PARAM_MASK = 0x00007ff8;  // LoadOnPvVolt to MonLoadOffTime
+
+    ESmart3Profile( ESmart3 &esmart3 );
+
+    // Set desired values and words to enforce. Mask 0 stops enforcing the item
+    void setBatParam( const ESmart3::BatParam_t &data, uint32_t mask = BAT_PARAM_MASK );
+    void setProParam( const ESmart3::ProParam_t &data, uint32_t mask = PRO_PARAM_MASK );
+    void setLoadParam( const ESmart3::LoadParam_t &data, uint32_t mask = LOAD_PARAM_MASK );
+
+    // Check next enforced item if its turn has come. Each item is checked once per interval
+    // Return false if the last check failed (bus error or verification mismatch)
+    bool handle( uint32_t interval_ms );
+
+    // Check next enforced item now and re-apply differing words
+    // Return false on bus error or verification mismatch
+    bool check();
+
+    // Statistics
+    uint32_t checks() const { return _checks; }  // items checked
+    uint32_t drifts() const { return _drifts; }  // checks that found differing words
+    uint32_t writes() const { return _writes; }  // SET frames sent to re-apply values
+    uint32_t errors() const { return _errors; }  // failed checks
+
+private:
+    enum { BAT, PRO, LOAD, ITEMS };
+
+    ESmart3 &_esmart3;
+    ESmart3::BatParam_t _batParam;
+    ESmart3::ProParam_t _proParam;
+    ESmart3::LoadParam_t _loadParam;
+    uint32_t _mask[ITEMS];
+    size_t _next;
+    uint32_t _prev;
+    bool _ok;
+    uint32_t _checks;
+    uint32_t _drifts;
+    uint32_t _writes;
+    uint32_t _errors;
+};
+
+#endif
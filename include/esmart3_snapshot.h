@@ -0,0 +1,94 @@
+#ifndef ESMART3_SNAPSHOT
+#define ESMART3_SNAPSHOT
+
+/*
+Lock free snapshot of an item structure for one writer and any number of readers
+
+The task polling the bus publishes each new item with publish(). Tasks on any core
+(e.g. web or mqtt) get a consistent copy with read() without mutexes, so a reader
+can never block the bus task (no priority inversion). It is a seqlock: publish() makes
+the sequence number odd, copies the value and makes it even again. read() copies
+between two loads of the sequence number and retries if it was odd or changed.
+Half the sequence number is the version of the value: readers can skip unchanged items.
+Each value carries the millis() of its sample (e.g. ESmart3::rxMillis()), copied consistently with it.
+
+Retries are bounded: if the writer is preempted while publishing and cannot run
+(e.g. a higher priority reader on the same core), read() gives up and the reader keeps its previous copy.
+The structure is trivially copyable and may be placed in shared memory (see examples/Daemon_ESmart3).
+
+Usage:
+    ESmart3Snapshot<ESmart3::ChgSts_t> chgSts;
+    if( esmart3.getChgSts(data) ) chgSts.publish(data, esmart3.rxMillis());  // bus task
+    ESmart3::ChgSts_t copy;
+    if( chgSts.read(copy) ) render(copy);                 // other tasks
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+// natural alignment for the atomic, also inside <atomic> if it is first included here
+// (esmart3.h packs everything after its structures)
+#pragma pack(push)
+#pragma pack()
+
+#include <atomic>
+#include <string.h>
+
+template <typename T>
+class ESmart3Snapshot {
+public:
+    ESmart3Snapshot() : _seq(0), _ms(0) { memset(&_value, 0, sizeof(_value)); }
+
+    // Writer only (one task): replace value sampled at millis() ms
+    void publish( const T &value, uint32_t ms ) {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &value, sizeof(_value));
+        _ms = ms;
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+    void publish( const T &value ) { publish(value, millis()); }
+
+    // Writer only: last published value and its sample time without copy
+    const T &value() const { return _value; }
+    uint32_t ms() const { return _ms; }
+
+    // Copy consistent value and optionally its version and sample time.
+    // Return false if nothing is published yet or no consistent copy was possible within tries
+    bool read( T &value, uint32_t *version = 0, unsigned tries = 100, uint32_t *ms = 0 ) const {
+        while( tries-- ) {
+            uint32_t seq = _seq.load(std::memory_order_acquire);
+            if( !(seq & 1) ) {
+                memcpy(&value, &_value, sizeof(value));
+                uint32_t sampled = _ms;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if( _seq.load(std::memory_order_relaxed) == seq ) {
+                    if( version ) {
+                        *version = seq / 2;
+                    }
+                    if( ms ) {
+                        *ms = sampled;
+                    }
+                    return seq != 0;
+                }
+            }
+            yield();
+        }
+        return false;
+    }
+
+    // Number of publishes so far, 0 if nothing is published yet
+    uint32_t version() const { return _seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    alignas(4) std::atomic<uint32_t> _seq;  // odd while publishing
+    uint32_t _ms;  // millis() of the sample
+    T _value;
+};
+
+#pragma pack(pop)
+
+#endif
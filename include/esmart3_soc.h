@@ -0,0 +1,103 @@
+#ifndef ESMART3_SOC
+#define ESMART3_SOC
+
+/*
+Battery state of charge by coulomb counting of eSmart3 ChgSts samples
+
+wBatCap of the controller is derived from the battery voltage and jumps with
+the load current. ESmart3Soc integrates the battery current wChgCurr - wLoadCurr
+of every sample instead (trapezoidal rule, charge current reduced by the
+charge efficiency) and limits the result to [0, capacity].
+Integration errors add up, so the charge is recalibrated:
+* full:  battery voltage >= fullVolt (or controller in float mode) while the
+         charge current is <= fullCurr, for at least settleMs
+* empty: battery voltage <= emptyVolt for at least settleMs
+Until the first recalibration the charge starts from wBatCap of the first sample.
+
+Intervals longer than maxGapMs are not integrated (device or bus was unavailable).
+State can be saved with state() and restored after a reboot with restore().
+
+Usage:
+    ESmart3Soc::config_t config = ESmart3Soc::defaults();
+    config.capacityMAh = 50000;
+    ESmart3Soc soc(config);
+    if( esmart3.getChgSts(data) ) soc.update(data);
+    if( soc.percent() < 20 ) esmart3.setLoad(false);
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Soc {
+public:
+    typedef struct config {
+        uint32_t capacityMAh;  // usable battery capacity
+        uint16_t efficiency;   // charge efficiency in per mille (e.g. 990 for LiFePO, 850 for lead-acid)
+        uint16_t fullVolt;     // dV
+        uint16_t fullCurr;     // dA, tail current at full
+        uint16_t emptyVolt;    // dV
+        uint32_t settleMs;     // full or empty condition must hold this long
+        uint32_t maxGapMs;     // longer intervals are not integrated
+    } config_t;
+
+    // Persistent part of the estimator
+    typedef struct state {
+        uint32_t magic;           // STATE_MAGIC if valid
+        uint32_t calibrations;    // full or empty recalibrations, 0: charge started from wBatCap
+        int64_t charge;           // in battery, 2 * dA * ms (trapezoid sums), < 0 if not yet known
+        uint64_t capacity;        // charge at 100%, same unit
+    } state_t;
+
+    static const uint32_t STATE_MAGIC = 0xe5e30501;
+
+    // 100Ah 12V LiFePO battery
+    static config_t defaults();
+
+    ESmart3Soc( const config_t &config = defaults() );
+
+    // Integrate battery current since previous sample. Call with every successfully read sample
+    void update( const ESmart3::ChgSts_t &data, uint32_t now_ms );
+    void update( const ESmart3::ChgSts_t &data ) { update(data, millis()); }
+
+    // Forget charge and previous sample: next sample starts from wBatCap again
+    void reset();
+
+    // For persisting and restoring. Return false if state is not valid or for another capacity
+    const state_t &state() const { return _state; }
+    bool restore( const state_t &state );
+
+    // State of charge in percent (0 - 100) and per mille
+    float soc() const;
+    uint16_t permille() const;
+    uint8_t percent() const { return (permille() + 5) / 10; }
+
+    // Charge in battery
+    uint32_t chargeMAh() const;
+
+    // Battery current of last sample in dA (> 0: charging)
+    int16_t current() const { return _valid ? (int16_t)(_prev.wChgCurr - _prev.wLoadCurr) : 0; }
+
+    // True if charge was recalibrated at least once since reset
+    bool calibrated() const { return _state.calibrations > 0; }
+
+private:
+    typedef struct condition {
+        bool met;        // condition is true since
+        bool done;       // recalibrated for this period of met
+        uint32_t since;
+    } condition_t;
+
+    bool settled( bool condition, condition_t &state, uint32_t now_ms );
+
+    config_t _config;
+    bool _valid;  // _prev holds a sample
+    uint32_t _prev_ms;
+    ESmart3::ChgSts_t _prev;
+    condition_t _full;
+    condition_t _empty;
+    state_t _state;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef ESMART3_STATS
+#define ESMART3_STATS
+
+/*
+Streaming statistics of all eSmart3 ChgSts fields
+
+Each sample added updates, per field and in constant time and memory:
+* count, mean and variance (Welford's algorithm, numerically stable)
+* min and max with the time they were seen
+* exponential moving averages over EMAS configurable time windows
+So summaries of any period are available without keeping or scanning samples.
+reset() starts a new period (e.g. after publishing a summary), moving averages continue.
+
+Fields are the ones of ESmart3::fields(ESmart3::ChgSts), e.g. index 2 is BatVolt.
+
+Usage:
+    ESmart3Stats stats;  // moving averages over 1 and 15 minutes
+    if( esmart3.getChgSts(data) ) stats.add(data, time(NULL));
+    Serial.printf("BatVolt mean %.1f dV\n", stats.stat(2).mean);
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Stats {
+public:
+    enum { FIELDS = 15, EMAS = 2 };
+
+    typedef struct stat {
+        uint32_t count;       // samples since reset
+        double mean;
+        double m2;            // sum of squared differences from mean
+        int32_t min;
+        int32_t max;
+        uint32_t minTime;     // time of first min sample
+        uint32_t maxTime;     // time of first max sample
+        float ema[EMAS];      // moving averages, not reset
+    } stat_t;
+
+    // Windows of the moving averages in seconds
+    ESmart3Stats( uint32_t ema1_s = 60, uint32_t ema2_s = 15 * 60 );
+
+    // Add sample taken at time (seconds, for min and max). now_ms is used for the moving averages
+    void add( const ESmart3::ChgSts_t &data, uint32_t time, uint32_t now_ms );
+    void add( const ESmart3::ChgSts_t &data, uint32_t time ) { add(data, time, millis()); }
+
+    // Start a new period: clear count, mean, variance, min and max
+    void reset();
+
+    // Statistics of field index (< FIELDS)
+    const stat_t &stat( size_t index ) const { return _stat[index]; }
+    double variance( size_t index ) const;
+    double stddev( size_t index ) const;
+
+    // Window of moving average in seconds
+    uint32_t window( size_t ema ) const { return ema < EMAS ? _window[ema] / 1000 : 0; }
+
+    // Return name of field index
+    static const char *fieldName( size_t index );
+
+private:
+    uint32_t _window[EMAS];  // ms
+    bool _valid;             // _prev_ms is time of previous sample
+    uint32_t _prev_ms;
+    stat_t _stat[FIELDS];
+};
+
+#endif
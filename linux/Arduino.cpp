@@ -0,0 +1,117 @@
+#include <Arduino.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+
+
+HostSerial Serial;
+
+
+static uint64_t monotonic_us() {
+    static uint64_t start = 0;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if( !start ) {
+        start = now;
+    }
+    return now - start;
+}
+
+uint32_t millis() {
+    return (uint32_t)(monotonic_us() / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t)monotonic_us();
+}
+
+void delay( uint32_t ms ) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+    while( nanosleep(&ts, &ts) != 0 );  // continue after signals
+}
+
+void yield() {
+    sched_yield();
+}
+
+
+size_t Print::write( const uint8_t *buffer, size_t size ) {
+    size_t n = 0;
+    while( n < size && write(buffer[n]) ) {
+        n++;
+    }
+    return n;
+}
+
+size_t Print::write( const char *str ) {
+    return str ? write((const uint8_t *)str, strlen(str)) : 0;
+}
+
+
+size_t Print::printf( const char *format, ... ) {
+    char buf[256];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if( len < 0 ) {
+        return 0;
+    }
+    if( (size_t)len >= sizeof(buf) ) {
+        char *big = (char *)malloc(len + 1);
+        if( !big ) {
+            return 0;
+        }
+        va_start(args, format);
+        vsnprintf(big, len + 1, format, args);
+        va_end(args);
+        size_t n = write((const uint8_t *)big, len);
+        free(big);
+        return n;
+    }
+    return write((const uint8_t *)buf, len);
+}
+
+
+size_t HostSerial::write( uint8_t c ) {
+    return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HostSerial::write( const uint8_t *buffer, size_t size ) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HostSerial::flush() {
+    fflush(stdout);
+}
+
+
+size_t Stream::readBytes( uint8_t *buffer, size_t length ) {
+    size_t n = 0;
+    while( n < length ) {
+        int c = timedRead();
+        if( c < 0 ) {
+            break;
+        }
+        buffer[n++] = (uint8_t)c;
+    }
+    return n;
+}
+
+int Stream::timedRead() {
+    uint32_t start = millis();
+    do {
+        int c = read();
+        if( c >= 0 ) {
+            return c;
+        }
+        yield();
+    } while( millis() - start < _timeout );
+    return -1;
+}
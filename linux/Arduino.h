@@ -0,0 +1,57 @@
+#ifndef ESMART3_LINUX_ARDUINO
+#define ESMART3_LINUX_ARDUINO
+
+/*
+Minimal Arduino API to build the Joba_ESmart3 library on Linux (e.g. Raspberry Pi or x86 gateway)
+
+Provides only what the library uses: millis(), micros(), delay(), yield(),
+pinMode() and digitalWrite() (no gpio on a host: direction is controlled
+by the tty, see ESmart3Tty), the Print and Stream classes (see Stream.h)
+and Serial as console (stdout, no input).
+Add this directory to the include path before the library include directory.
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOW 0
+#define HIGH 1
+
+#define INPUT 0
+#define OUTPUT 1
+
+// Milliseconds and microseconds since first call (monotonic clock)
+uint32_t millis();
+uint32_t micros();
+
+void delay( uint32_t ms );
+void yield();
+
+// No gpio on a host
+inline void pinMode( int pin, int mode ) { (void)pin; (void)mode; }
+inline void digitalWrite( int pin, int value ) { (void)pin; (void)value; }
+
+#include <Stream.h>
+
+class HostSerial : public Stream {
+public:
+    void begin( unsigned long baud ) { (void)baud; }
+
+    size_t write( uint8_t c ) override;
+    size_t write( const uint8_t *buffer, size_t size ) override;
+    using Print::write;
+    void flush() override;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef ESMART3_LINUX_STREAM
+#define ESMART3_LINUX_STREAM
+
+/*
+Arduino Print and Stream classes for Linux, see Arduino.h
+
+Same interface as the Arduino core, but readBytes() is virtual,
+so a transport can wait for data with poll() instead of spinning on millis().
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write( uint8_t c ) = 0;
+    virtual size_t write( const uint8_t *buffer, size_t size );
+    size_t write( const char *str );
+
+    size_t print( const char *str ) { return write(str); }
+    size_t println( const char *str = "" ) { return write(str) + write("\r\n"); }
+    size_t printf( const char *format, ... ) __attribute__((format(printf, 2, 3)));
+
+    // Wait until all written bytes are sent
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+    Stream() : _timeout(1000) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    // Max ms to wait for the next byte in readBytes()
+    void setTimeout( unsigned long timeout ) { _timeout = timeout; }
+    unsigned long getTimeout() const { return _timeout; }
+
+    // Read up to length bytes. Return number of bytes read (< length on timeout)
+    virtual size_t readBytes( uint8_t *buffer, size_t length );
+    size_t readBytes( char *buffer, size_t length ) { return readBytes((uint8_t *)buffer, length); }
+
+protected:
+    int timedRead();
+
+    unsigned long _timeout;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <esmart3_sim.h>
+
+#pragma pack(push)
+#pragma pack()  // natural alignment for struct termios (esmart3.h packs its structures)
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#pragma pack(pop)
+
+
+ESmart3Sim::ESmart3Sim() : _fd(-1), _frames(0) {
+    memset(_mem, 0, sizeof(_mem));
+}
+
+bool ESmart3Sim::begin() {
+    ESmart3::Information_t *info = (ESmart3::Information_t *)_mem[ESmart3::Information];
+    memcpy(info->wSerial, "SIM00001", sizeof(info->wSerial));
+    memcpy(info->wDate, "20221024", sizeof(info->wDate));
+    memcpy(info->wFirmWare, "V1.0", sizeof(info->wFirmWare));
+    memcpy(info->wModel, "Simulated eSmart", sizeof(info->wModel));
+
+    ESmart3::ChgSts_t *chgSts = (ESmart3::ChgSts_t *)_mem[ESmart3::ChgSts];
+    chgSts->wChgMode = ESmart3::CHG_MPPT;
+    chgSts->wBatVolt = 132;
+    chgSts->wOutVolt = 132;
+    chgSts->wLoadVolt = 132;
+    chgSts->wBatTemp = 20;
+    chgSts->wInnerTemp = 30;
+    chgSts->wBatCap = 80;
+
+    _fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if( _fd < 0 || grantpt(_fd) != 0 || unlockpt(_fd) != 0 ) {
+        return false;
+    }
+    struct termios tio;
+    if( tcgetattr(_fd, &tio) == 0 ) {
+        cfmakeraw(&tio);
+        tcsetattr(_fd, TCSANOW, &tio);
+    }
+
+    pthread_t thread;
+    if( pthread_create(&thread, 0, run, this) != 0 ) {
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+const char *ESmart3Sim::device() const {
+    return _fd < 0 ? 0 : ptsname(_fd);
+}
+
+
+size_t ESmart3Sim::answer( const uint8_t *frame, uint8_t *out ) {
+    uint8_t item = frame[4];
+    uint8_t length = frame[5];
+    uint8_t crc = 0;
+
+    for( size_t i = 0; i < 6u + length + 1; i++ ) {
+        crc -= frame[i];
+    }
+    if( crc != 0 ) {
+        return 0;  // device ignores corrupt frames
+    }
+
+    // let values move a bit like on a real device
+    ESmart3::ChgSts_t *chgSts = (ESmart3::ChgSts_t *)_mem[ESmart3::ChgSts];
+    chgSts->wPvVolt = 380 + _frames % 16;
+    chgSts->wChgCurr = 50 + _frames % 8;
+    chgSts->wChgPower = chgSts->wBatVolt * chgSts->wChgCurr / 100;
+
+    if( item >= ITEMS || length < 2 ) {
+        return reply(frame, out, ESmart3::NACK, 0, 0);
+    }
+    if( frame[3] == ESmart3::GET && length == 3 && frame[8] <= ESmart3::MAX_RESULT
+     && frame[6] * 2u + frame[8] <= ITEM_SIZE ) {
+        return reply(frame, out, ESmart3::ACK, &_mem[item][frame[6] * 2], frame[8]);
+    }
+    if( frame[3] == ESmart3::SET && frame[6] * 2u + length - 2 <= ITEM_SIZE ) {
+        memcpy(&_mem[item][frame[6] * 2], &frame[8], length - 2);
+        return reply(frame, out, ESmart3::ACK, 0, 0);
+    }
+    return reply(frame, out, ESmart3::NACK, 0, 0);
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+void *ESmart3Sim::run( void *arg ) {
+    ESmart3Sim &sim = *(ESmart3Sim *)arg;
+    uint8_t frame[FRAME_SIZE];
+    size_t len = 0;
+
+    for(;;) {
+        ssize_t rc = read(sim._fd, &frame[len], len < 6 ? 1 : 6 + frame[5] + 1 - len);
+        if( rc < 0 && errno == EINTR ) {
+            continue;
+        }
+        if( rc <= 0 ) {
+            break;  // pty closed
+        }
+        len += rc;
+        if( frame[0] != 0xaa ) {
+            len = 0;  // resync on start byte
+        }
+        else if( len >= 6 && frame[5] > 120 ) {
+            len = 0;
+        }
+        else if( len >= 6 && len == 6u + frame[5] + 1 ) {
+            uint8_t out[FRAME_SIZE];
+            size_t n = sim.answer(frame, out);
+            if( n && write(sim._fd, out, n) != (ssize_t)n ) {
+                perror("sim write");
+            }
+            len = 0;
+        }
+    }
+    return 0;
+}
+
+// Build reply frame in out, len is at most ESmart3::MAX_RESULT. Return its length
+size_t ESmart3Sim::reply( const uint8_t *frame, uint8_t *out, uint8_t command, const uint8_t *data, uint8_t len ) {
+    size_t n = 0;
+    uint8_t crc = 0;
+
+    out[n++] = 0xaa;
+    out[n++] = ESmart3::MPPT;
+    out[n++] = ESmart3::BROADCAST;
+    out[n++] = command;
+    out[n++] = frame[4];
+    out[n++] = data ? len + 2 : 0;
+    if( data ) {
+        out[n++] = frame[6];
+        out[n++] = frame[7];
+        memcpy(&out[n], data, len);
+        n += len;
+    }
+    for( size_t i = 0; i < n; i++ ) {
+        crc -= out[i];
+    }
+    out[n++] = crc;
+    _frames++;
+    return n;
+}
@@ -0,0 +1,52 @@
+#ifndef ESMART3_SIM
+#define ESMART3_SIM
+
+/*
+Simulated eSmart3 on a Linux pty pair for tests without hardware
+
+A thread answers GET and SET frames on the master side from item memory,
+frames with bad crc are ignored like on the device. ChgSts values move a bit with each frame.
+Use device() as tty name for ESmart3Tty (kernel RS485 direction control is not possible on a pty).
+
+Usage:
+    ESmart3Sim sim;
+    if( sim.begin() && tty.begin(sim.device()) ) esmart3.getChgSts(data);
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <esmart3.h>
+
+class ESmart3Sim {
+public:
+    enum { ITEMS = ESmart3::EngSave + 1, ITEM_SIZE = 400, FRAME_SIZE = 6 + 120 + 1 };
+
+    ESmart3Sim();
+
+    // Open pty pair, init item memory and start answering frames. Return false on errors (see errno)
+    bool begin();
+
+    // Slave tty name or NULL before begin()
+    const char *device() const;
+
+    // Item memory, indexed by word offset. Changes are seen by the next frame
+    uint8_t *mem( ESmart3::item_t item ) { return _mem[item]; }
+
+    // Answered frames
+    uint32_t frames() const { return _frames; }
+
+    // Answer one complete frame (6 + frame[5] + 1 bytes, frame[5] <= 120) like the device does.
+    // Return length of the reply in out (FRAME_SIZE bytes), 0 if the frame is ignored (bad crc)
+    size_t answer( const uint8_t *frame, uint8_t *out );
+
+private:
+    static void *run( void *arg );
+    size_t reply( const uint8_t *frame, uint8_t *out, uint8_t command, const uint8_t *data, uint8_t len );
+
+    int _fd;  // pty master
+    volatile uint32_t _frames;
+    uint8_t _mem[ITEMS][ITEM_SIZE];
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include <esmart3_tty.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+
+ESmart3Tty::ESmart3Tty() : _fd(-1), _low_latency(false), _writing(false), _head(0), _tail(0) {
+}
+
+ESmart3Tty::~ESmart3Tty() {
+    end();
+}
+
+bool ESmart3Tty::begin( const char *device, uint32_t baud, bool rs485 ) {
+    speed_t speed;
+    switch( baud ) {
+        case 1200: speed = B1200; break;
+        case 2400: speed = B2400; break;
+        case 4800: speed = B4800; break;
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        default: errno = EINVAL; return false;
+    }
+
+    end();
+    _fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if( _fd < 0 ) {
+        return false;
+    }
+
+    struct termios tio;
+    if( tcgetattr(_fd, &tio) != 0 ) {
+        end();
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if( cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0 || tcsetattr(_fd, TCSANOW, &tio) != 0 ) {
+        end();
+        return false;
+    }
+
+    // optional: not every driver (e.g. pty) knows it
+    struct serial_struct serial;
+    if( ioctl(_fd, TIOCGSERIAL, &serial) == 0 ) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        _low_latency = ioctl(_fd, TIOCSSERIAL, &serial) == 0;
+    }
+
+    if( rs485 ) {
+        struct serial_rs485 conf;
+        memset(&conf, 0, sizeof(conf));
+        conf.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;  // RTS low after send: receive
+        if( ioctl(_fd, TIOCSRS485, &conf) != 0 ) {
+            int err = errno;
+            end();
+            errno = err;
+            return false;
+        }
+    }
+
+    tcflush(_fd, TCIOFLUSH);
+    return true;
+}
+
+void ESmart3Tty::end() {
+    if( _fd >= 0 ) {
+        close(_fd);
+        _fd = -1;
+    }
+    _low_latency = false;
+    _writing = false;
+    _head = _tail = 0;
+}
+
+size_t ESmart3Tty::write( uint8_t c ) {
+    return write(&c, 1);
+}
+
+size_t ESmart3Tty::write( const uint8_t *buffer, size_t size ) {
+    if( _fd >= 0 && !_writing ) {
+        _writing = true;
+        _head = _tail = 0;  // new request: drop stale input
+        tcflush(_fd, TCIFLUSH);
+    }
+
+    size_t n = 0;
+    while( _fd >= 0 && n < size ) {
+        ssize_t rc = ::write(_fd, buffer + n, size - n);
+        if( rc > 0 ) {
+            n += rc;
+        }
+        else if( rc < 0 && errno == EAGAIN ) {
+            struct pollfd pfd = { _fd, POLLOUT, 0 };
+            if( poll(&pfd, 1, _timeout) <= 0 ) {
+                break;
+            }
+        }
+        else if( !(rc < 0 && errno == EINTR) ) {
+            break;
+        }
+    }
+    return n;
+}
+
+int ESmart3Tty::available() {
+    int pending = 0;
+    if( _fd >= 0 && ioctl(_fd, FIONREAD, &pending) != 0 ) {
+        pending = 0;
+    }
+    return (int)(_tail - _head) + pending;
+}
+
+int ESmart3Tty::read() {
+    if( _head == _tail && !fill(0) ) {
+        return -1;
+    }
+    return _buf[_head++];
+}
+
+int ESmart3Tty::peek() {
+    if( _head == _tail && !fill(0) ) {
+        return -1;
+    }
+    return _buf[_head];
+}
+
+void ESmart3Tty::flush() {
+    if( _fd >= 0 ) {
+        tcdrain(_fd);
+    }
+}
+
+size_t ESmart3Tty::readBytes( uint8_t *buffer, size_t length ) {
+    size_t n = 0;
+    while( n < length ) {
+        if( _head == _tail && !fill(_timeout) ) {
+            break;  // no byte within timeout
+        }
+        size_t chunk = _tail - _head;
+        if( chunk > length - n ) {
+            chunk = length - n;
+        }
+        memcpy(buffer + n, &_buf[_head], chunk);
+        _head += chunk;
+        n += chunk;
+    }
+    return n;
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+bool ESmart3Tty::fill( int timeout_ms ) {
+    if( _fd < 0 ) {
+        return false;
+    }
+    _writing = false;
+    _head = _tail = 0;
+    for(;;) {
+        ssize_t rc = ::read(_fd, _buf, sizeof(_buf));
+        if( rc > 0 ) {
+            _tail = rc;
+            return true;
+        }
+        if( rc < 0 && errno == EINTR ) {
+            continue;
+        }
+        if( rc < 0 && errno != EAGAIN ) {
+            return false;
+        }
+        // nothing there yet
+        if( timeout_ms <= 0 ) {
+            return false;
+        }
+        struct pollfd pfd = { _fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if( ready < 0 && errno == EINTR ) {
+            continue;  // restarts the timeout, good enough for a per byte timeout
+        }
+        if( ready <= 0 || !(pfd.revents & POLLIN) ) {
+            return false;
+        }
+        timeout_ms = 0;  // data is there now
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef ESMART3_TTY
+#define ESMART3_TTY
+
+/*
+Linux tty as Stream for the ESmart3 class, e.g. a USB-RS485 adapter on a Raspberry Pi or x86 gateway
+
+* raw 8N1 without flow control, low latency mode if the driver supports it
+  (USB serial adapters otherwise deliver received bytes in up to 16ms chunks)
+* RS485 direction control by the kernel (TIOCSRS485, RTS active while sending),
+  so ESmart3::begin() gets dir_pin -1. Adapters with automatic direction do not need it
+* readBytes() waits with poll() for the next byte up to the Stream timeout instead of spinning
+* the first write after reading drops received bytes not yet read, so a late reply
+  to an earlier request cannot be taken as reply to the next one
+
+Usage:
+    ESmart3Tty tty;
+    ESmart3 esmart3(tty);
+    if( !tty.begin("/dev/ttyUSB0") ) perror("tty");
+    esmart3.begin();
+    esmart3.getChgSts(data);
+
+Author: Joachim.Banzhaf@gmail.com
+License: GPL V2
+*/
+
+#include <Arduino.h>
+
+// same layout whether or not esmart3.h (which packs everything after its structures) was included first
+#pragma pack(push)
+#pragma pack()
+
+class ESmart3Tty : public Stream {
+public:
+    ESmart3Tty();
+    ~ESmart3Tty();
+
+    // Open device with baud (9600 for eSmart3). Kernel direction control is enabled if rs485 is true.
+    // Return false if device cannot be opened or configured (see errno)
+    bool begin( const char *device, uint32_t baud = 9600, bool rs485 = false );
+
+    // Close device
+    void end();
+
+    // File descriptor of the open device or -1
+    int fd() const { return _fd; }
+
+    // True if the driver accepted low latency mode
+    bool lowLatency() const { return _low_latency; }
+
+    size_t write( uint8_t c ) override;
+    size_t write( const uint8_t *buffer, size_t size ) override;
+    using Print::write;
+
+    int available() override;
+    int read() override;
+    int peek() override;
+
+    // Wait until all written bytes are sent
+    void flush() override;
+
+    size_t readBytes( uint8_t *buffer, size_t length ) override;
+    using Stream::readBytes;
+
+private:
+    bool fill( int timeout_ms );  // read available bytes into _buf, wait up to timeout_ms if there are none
+
+    int _fd;
+    bool _low_latency;
+    bool _writing;  // bytes were written since last read
+    uint8_t _buf[256];
+    size_t _head;  // next byte to read
+    size_t _tail;  // end of received bytes
+};
+
+#pragma pack(pop)
+
+#endif
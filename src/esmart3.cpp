@@ -3,8 +3,9 @@
 #include <string.h>
 
 
-// Debug
+// Debug (build with -DESMART3_DEBUG to dump frames of set commands)
 
+#ifdef ESMART3_DEBUG
 static void hex( const char *label, const uint8_t *data, size_t length ) {
     Serial.printf("%s:", label);
     while( length-- ) {
@@ -12,15 +13,24 @@ static void hex( const char *label, const uint8_t *data, size_t length ) {
     }
     Serial.println();
 }
+#endif
+
+
+// Frame limits
+
+// Max data bytes in one frame: header.length limit minus 2 offset bytes
+static const size_t MAX_DATA = 120 - 2;
+
+// Equal masked words between two changed words that are rewritten instead of starting a new SET frame.
+// A frame costs 9 command + 7 ack bytes plus command delay, a rewritten word only 2 bytes.
+// Unmasked words are never written: a frame always ends before them.
+static const size_t MERGE_GAP = 2;
 
 
 // Basic methods
 
 ESmart3::ESmart3( Stream &serial, uint32_t *prev, uint8_t command_delay_ms ) 
-    : _serial(serial), _delay(command_delay_ms), _prev(prev), _dir_pin(-1) {
-    if (!_prev) {
-        _prev = &_prev_local;
-    }
+    : _serial(serial), _delay(command_delay_ms), _prev_local(0), _prev(prev), _rx(0), _dir_pin(-1) {
 }
 
 void ESmart3::begin( int dir_pin ) {
@@ -31,7 +41,7 @@ void ESmart3::begin( int dir_pin ) {
     }
 }
 
-bool ESmart3::execute( header_t &header, uint8_t *command, uint8_t *result ) {
+bool ESmart3::execute( header_t &header, uint8_t *command, uint8_t *result, size_t capacity ) {
     uint8_t crc;
     uint8_t offset[2];
 
@@ -39,8 +49,8 @@ bool ESmart3::execute( header_t &header, uint8_t *command, uint8_t *result ) {
         return false;
     }
 
-    uint32_t remaining = _delay - (millis() - *_prev);
-    if( remaining <= _delay ) {
+    uint32_t remaining = _delay - (millis() - (_prev ? *_prev : _prev_local));
+    if( remaining && remaining <= _delay ) {
         delay(remaining);
     }
 
@@ -58,16 +68,34 @@ bool ESmart3::execute( header_t &header, uint8_t *command, uint8_t *result ) {
         digitalWrite(_dir_pin, LOW);  // read mode (default)
     }
 
+    if( !result ) {
+        capacity = 0;
+    }
+
+    uint32_t rx = 0;
     if( rc ) {
-        rc = (_serial.readBytes((uint8_t *)&header, sizeof(header)) == sizeof(header))
+        rc = _serial.readBytes((uint8_t *)&header, sizeof(header)) == sizeof(header);
+        rx = millis();  // reply is on its way, the rest takes a fixed time at 9600 baud
+
+        // length is checked against the frame limit and the result buffer before any data byte is stored
+        rc = rc
           && (header.start == 0xaa && header.length <= 120)
+          && (header.length < 2 || (size_t)(header.length - 2) <= capacity)
           && (header.length < 2 || _serial.readBytes(offset, 2) == 2)
-          && (header.length < 2 || (result && _serial.readBytes(result, header.length - 2) == header.length - 2))
+          && (header.length < 2 || _serial.readBytes(result, header.length - 2) == (size_t)(header.length - 2))
           && (_serial.readBytes(&crc, 1) == 1)
           && isValid(header, header.length < 2 ? 0 : offset, result, crc);
     }
 
-    *_prev = millis();
+    if( _prev ) {
+        *_prev = millis();
+    }
+    else {
+        _prev_local = millis();
+    }
+    if( rc ) {
+        _rx = rx;
+    }
 
     return rc;
 }
@@ -82,26 +110,17 @@ static uint32_t dwSwap( uint32_t &dw ) {
 // public Get-Commands
 
 bool ESmart3::getChgSts( ChgSts_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, ChgSts, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    bool rc = execute(header, cmd, addr);
+    bool rc = getRange(ChgSts, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
     dwSwap(data.dwCO2);
     return rc;
 }
 
 bool ESmart3::getBatParam( BatParam_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, BatParam, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    return execute(header, cmd, addr);
+    return getRange(BatParam, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
 }
 
 bool ESmart3::getLog( Log_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, Log, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    bool rc = execute(header, cmd, addr);
+    bool rc = getRange(Log, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
     dwSwap(data.dwTodayEng);
     dwSwap(data.dwMonthEng);
     dwSwap(data.dwTotalEng);
@@ -112,59 +131,38 @@ bool ESmart3::getLog( Log_t &data, size_t start, size_t end ) {
 }
 
 bool ESmart3::getParameters( Parameters_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, Parameters, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    return execute(header, cmd, addr);
+    return getRange(Parameters, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
 }
 
 bool ESmart3::getLoadParam( LoadParam_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, LoadParam, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    return execute(header, cmd, addr);
+    return getRange(LoadParam, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
 }
 
 bool ESmart3::getProParam( ProParam_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, ProParam, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    return execute(header, cmd, addr);
+    return getRange(ProParam, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
 }
 
 bool ESmart3::getInformation( Information_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, Information, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    return execute(header, cmd, addr);
+    return getRange(Information, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
 }
 
 bool ESmart3::getEngSave( EngSave_t &data, size_t start, size_t end ) {
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, EngSave, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, start, end);
-    return execute(header, cmd, addr);
+    return getRange(EngSave, (uint8_t *)&data + start * 2, start, end, sizeof(data) / 2);
 }
 
 bool ESmart3::getLoad( bool &on ) {
-    LoadParam_t data = {0};
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, LoadParam, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, 0x0f, 0x10);
-    if( execute(header, cmd, addr) ) {
-        on = (data.wLoadSts != 0);
+    uint16_t loadSts = 0;
+    if( getRange(LoadParam, (uint8_t *)&loadSts, 0x0f, 0x10, 0x10) ) {
+        on = (loadSts != 0);
         return true;
     }
     return false;
 }
 
 bool ESmart3::getDisplayTemperatureUnit( tempUnit_t &unit ) {
-    TempParam_t data = {0};
-    uint8_t cmd[3];
-    header_t header = { 0, MPPT, BROADCAST, GET, TempParam, sizeof(cmd) };
-    uint8_t *addr = initGetOffset(cmd, (uint8_t *)&data, 4, 5);
-    if( execute(header, cmd, addr) ) {
-        unit = data.bBatTempSel ? ESmart3::FAHRENHEIT : ESmart3::CELSIUS;
+    uint16_t batTempSel = 0;
+    if( getRange(TempParam, (uint8_t *)&batTempSel, 4, 5, 5) ) {
+        unit = batTempSel ? ESmart3::FAHRENHEIT : ESmart3::CELSIUS;
         return true;
     }
     return false;
@@ -181,10 +179,15 @@ bool ESmart3::setBatParam( BatParam_t &data, size_t start, size_t end ) {
         return false;
     } 
     initSetOffset(cmd, (uint8_t *)&words[start], start, end);
-    // hex("hdr", (uint8_t *)&header, sizeof(header));
-    // hex("cmd", cmd, sizeof(cmd));
-    return execute(header, cmd, 0) && header.command == ACK;
-    // hex("hdr", (uint8_t *)&header, sizeof(header));
+#ifdef ESMART3_DEBUG
+    hex("hdr", (uint8_t *)&header, sizeof(header));
+    hex("cmd", cmd, sizeof(cmd));
+#endif
+    bool rc = execute(header, cmd, 0) && header.command == ACK;
+#ifdef ESMART3_DEBUG
+    hex("hdr", (uint8_t *)&header, sizeof(header));
+#endif
+    return rc;
 }
 
 bool ESmart3::setProParam( ProParam_t &data, size_t start, size_t end ) {
@@ -198,6 +201,103 @@ bool ESmart3::setProParam( ProParam_t &data, size_t start, size_t end ) {
     return execute(header, cmd, 0) && header.command == ACK;
 }
 
+bool ESmart3::updateBatParam( BatParam_t &data, size_t start, size_t end, size_t *frames ) {
+    if( (end - start) * 2 >= sizeof(data) ) {
+        return false;
+    }
+    return update(BatParam, (uint16_t *)&data, rangeMask(start, end), frames);
+}
+
+bool ESmart3::updateProParam( ProParam_t &data, size_t start, size_t end, size_t *frames ) {
+    if( (end - start) * 2 >= sizeof(data) ) {
+        return false;
+    }
+    return update(ProParam, (uint16_t *)&data, rangeMask(start, end), frames);
+}
+
+bool ESmart3::updateLoadParam( LoadParam_t &data, size_t start, size_t end, size_t *frames ) {
+    if( (end - start) * 2 >= sizeof(data) ) {
+        return false;
+    }
+    return update(LoadParam, (uint16_t *)&data, rangeMask(start, end), frames);
+}
+
+bool ESmart3::update( item_t item, const uint16_t *words, uint32_t mask, size_t *frames ) {
+    uint16_t current[32];  // device values, indexed by word offset
+    uint16_t desired[32];  // masked words from caller, others from device
+    size_t sent = 0;
+
+    if( frames ) {
+        *frames = 0;
+    }
+    if( !mask ) {
+        return true;
+    }
+
+    size_t start = 0;
+    while( !(mask & (1ul << start)) ) {
+        start++;
+    }
+    size_t end = 32;
+    while( !(mask & (1ul << (end - 1))) ) {
+        end--;
+    }
+
+    // one read covers all masked words, including unmasked ones between them
+    size_t limit = itemWords(item);
+    if( !getRange(item, (uint8_t *)&current[start], start, end, limit < 32 ? limit : 32) ) {
+        return false;
+    }
+    for( size_t i = start; i < end; i++ ) {
+        desired[i] = (mask & (1ul << i)) ? words[i] : current[i];
+    }
+
+    size_t first = end;  // start of span that was written
+    size_t last = start;  // end of span that was written
+    size_t pos = start;
+    while( pos < end ) {
+        if( current[pos] == desired[pos] ) {
+            pos++;
+            continue;
+        }
+        // run starts with changed word at pos and ends after last changed word within reach,
+        // but never includes an unmasked word (it may have changed since it was read)
+        size_t stop = pos + 1;
+        for( size_t i = stop; i < end && i - stop <= MERGE_GAP && (mask & (1ul << i)); i++ ) {
+            if( current[i] != desired[i] ) {
+                stop = i + 1;
+            }
+        }
+        if( !setRange(item, (const uint8_t *)&desired[pos], pos, stop) ) {
+            return false;
+        }
+        sent++;
+        if( frames ) {
+            *frames = sent;
+        }
+        if( pos < first ) {
+            first = pos;
+        }
+        last = stop;
+        pos = stop;
+    }
+
+    if( !sent ) {
+        return true;  // device already had the desired values
+    }
+
+    // read back only the span that was written and compare the masked words
+    if( !getRange(item, (uint8_t *)&current[first], first, last, limit < 32 ? limit : 32) ) {
+        return false;
+    }
+    for( size_t i = first; i < last; i++ ) {
+        if( (mask & (1ul << i)) && current[i] != desired[i] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool ESmart3::setMaxChargeCurrent( uint16_t deciAmps ) {
     uint8_t cmd[4];
     header_t header = { 0, MPPT, BROADCAST, SET, BatParam, sizeof(cmd) };
@@ -247,20 +347,199 @@ bool ESmart3::setSwitchEnable( bool on ) {
     header_t header = { 0, MPPT, BROADCAST, SET, Log, sizeof(cmd) };
     uint16_t switchEnable = on ? 1 : 0;
     initSetOffset(cmd, (uint8_t *)&switchEnable, 0x17, 0x18);
-    // hex("hdr", (uint8_t *)&header, sizeof(header));
-    // hex("cmd", cmd, sizeof(cmd));
+#ifdef ESMART3_DEBUG
+    hex("hdr", (uint8_t *)&header, sizeof(header));
+    hex("cmd", cmd, sizeof(cmd));
+#endif
     bool rc = execute(header, cmd, 0) && header.command == ACK;
-    // hex("hdr", (uint8_t *)&header, sizeof(header));
+#ifdef ESMART3_DEBUG
+    hex("hdr", (uint8_t *)&header, sizeof(header));
+#endif
     return rc;
 }
 
 
+// Static helper functions
+
+static const ESmart3::field_t chgStsFields[] = {
+    { "ChgMode",        0x00, ESmart3::U16 },
+    { "PvVolt",         0x01, ESmart3::U16 },
+    { "BatVolt",        0x02, ESmart3::U16 },
+    { "ChgCurr",        0x03, ESmart3::U16 },
+    { "OutVolt",        0x04, ESmart3::U16 },
+    { "LoadVolt",       0x05, ESmart3::U16 },
+    { "LoadCurr",       0x06, ESmart3::U16 },
+    { "ChgPower",       0x07, ESmart3::U16 },
+    { "LoadPower",      0x08, ESmart3::U16 },
+    { "BatTemp",        0x09, ESmart3::I16 },
+    { "InnerTemp",      0x0a, ESmart3::I16 },
+    { "BatCap",         0x0b, ESmart3::U16 },
+    { "CO2",            0x0c, ESmart3::U32 },
+    { "Fault",          0x0e, ESmart3::U16 },
+    { "SystemReminder", 0x0f, ESmart3::U16 }
+};
+
+// Parameter tables only list the words updateXParam() writes
+static const ESmart3::field_t batParamFields[] = {
+    { "BatType",         0x01, ESmart3::U16 },
+    { "BatSysType",      0x02, ESmart3::U16 },
+    { "BulkVolt",        0x03, ESmart3::U16 },
+    { "FloatVolt",       0x04, ESmart3::U16 },
+    { "MaxChgCurr",      0x05, ESmart3::U16 },
+    { "MaxDisChgCurr",   0x06, ESmart3::U16 },
+    { "EqualizeChgVolt", 0x07, ESmart3::U16 },
+    { "EqualizeChgTime", 0x08, ESmart3::U16 }
+};
+
+static const ESmart3::field_t proParamFields[] = {
+    { "LoadOvp",         0x01, ESmart3::U16 },
+    { "LoadUvp",         0x02, ESmart3::U16 },
+    { "BatOvp",          0x03, ESmart3::U16 },
+    { "BatOvB",          0x04, ESmart3::U16 },
+    { "BatUvp",          0x05, ESmart3::U16 },
+    { "BatUvB",          0x06, ESmart3::U16 }
+};
+
+static const ESmart3::field_t loadParamFields[] = {
+    { "LoadOnPvVolt",         0x03, ESmart3::U16 },
+    { "LoadOffPvVolt",        0x04, ESmart3::U16 },
+    { "PvContrlTurnOnDelay",  0x05, ESmart3::U16 },
+    { "PvContrlTurnOffDelay", 0x06, ESmart3::U16 },
+    { "AftLoadOnHour",        0x07, ESmart3::I16 },
+    { "AftLoadOnMinute",      0x08, ESmart3::I16 },
+    { "AftLoadOffHour",       0x09, ESmart3::I16 },
+    { "AftLoadOffMinute",     0x0a, ESmart3::I16 },
+    { "MonLoadOnHour",        0x0b, ESmart3::I16 },
+    { "MonLoadOnMinute",      0x0c, ESmart3::I16 },
+    { "MonLoadOffHour",       0x0d, ESmart3::I16 },
+    { "MonLoadOffMinute",     0x0e, ESmart3::I16 }
+};
+
+const ESmart3::field_t *ESmart3::fields( item_t item, size_t &count ) {
+    switch( item ) {
+        case ChgSts:
+            count = sizeof(chgStsFields) / sizeof(*chgStsFields);
+            return chgStsFields;
+        case BatParam:
+            count = sizeof(batParamFields) / sizeof(*batParamFields);
+            return batParamFields;
+        case ProParam:
+            count = sizeof(proParamFields) / sizeof(*proParamFields);
+            return proParamFields;
+        case LoadParam:
+            count = sizeof(loadParamFields) / sizeof(*loadParamFields);
+            return loadParamFields;
+        default:
+            count = 0;
+            return 0;
+    }
+}
+
+const ESmart3::field_t *ESmart3::field( item_t item, const char *name ) {
+    size_t count;
+    const field_t *table = fields(item, count);
+    for( size_t i = 0; i < count; i++ ) {
+        if( strcmp(table[i].name, name) == 0 ) {
+            return &table[i];
+        }
+    }
+    return 0;
+}
+
+int32_t ESmart3::value( const void *data, const field_t &field ) {
+    const uint8_t *addr = (const uint8_t *)data + field.offset * 2;
+    switch( field.type ) {
+        case I16: {
+            int16_t i16;
+            memcpy(&i16, addr, sizeof(i16));
+            return i16;
+        }
+        case U32: {
+            uint32_t u32;
+            memcpy(&u32, addr, sizeof(u32));
+            return (int32_t)u32;
+        }
+        default: {
+            uint16_t u16;
+            memcpy(&u16, addr, sizeof(u16));
+            return u16;
+        }
+    }
+}
+
+
 // Private Stuff (used internally, not by library user)
 
+// Read words [start, end[ of item into data (data receives word start at offset 0, limit is the word offset after the buffer)
+// Ranges larger than one frame are read in back-to-back chunks of maximal size
+bool ESmart3::getRange( item_t item, uint8_t *data, size_t start, size_t end, size_t limit ) {
+    if( start >= end || end > limit ) {
+        return false;
+    }
+    while( start < end ) {
+        size_t stop = (end - start) * 2 > MAX_DATA ? start + MAX_DATA / 2 : end;
+        uint8_t cmd[3];
+        header_t header = { 0, MPPT, BROADCAST, GET, (uint8_t)item, sizeof(cmd) };
+        initGetOffset(cmd, data, start, stop);
+        if( !execute(header, cmd, data, (stop - start) * 2) || header.length != (stop - start) * 2 + 2 ) {
+            return false;
+        }
+        data += (stop - start) * 2;
+        start = stop;
+    }
+    return true;
+}
+
+// Write words [start, end[ of item from data (data holds word start at offset 0)
+// Ranges larger than one frame are written in back-to-back chunks of maximal size
+bool ESmart3::setRange( item_t item, const uint8_t *data, size_t start, size_t end ) {
+    if( start >= end ) {
+        return false;
+    }
+    while( start < end ) {
+        size_t stop = (end - start) * 2 > MAX_DATA ? start + MAX_DATA / 2 : end;
+        uint8_t cmd[MAX_DATA + 2];
+        header_t header = { 0, MPPT, BROADCAST, SET, (uint8_t)item, (uint8_t)((stop - start) * 2 + 2) };
+        initSetOffset(cmd, data, start, stop);
+        if( !execute(header, cmd, 0) || header.command != ACK ) {
+            return false;
+        }
+        data += (stop - start) * 2;
+        start = stop;
+    }
+    return true;
+}
+
+// Return number of words of item structure, 0 if unknown
+size_t ESmart3::itemWords( item_t item ) {
+    switch( item ) {
+        case ChgSts:        return sizeof(ChgSts_t) / 2;
+        case BatParam:      return sizeof(BatParam_t) / 2;
+        case Log:           return sizeof(Log_t) / 2;
+        case Parameters:    return sizeof(Parameters_t) / 2;
+        case LoadParam:     return sizeof(LoadParam_t) / 2;
+        case RemoteControl: return sizeof(RemoteControl_t) / 2;
+        case ProParam:      return sizeof(ProParam_t) / 2;
+        case Information:   return sizeof(Information_t) / 2;
+        case TempParam:     return sizeof(TempParam_t) / 2;
+        case EngSave:       return sizeof(EngSave_t) / 2;
+        default:            return 0;
+    }
+}
+
+// Mask with bits [start, end[ set (end <= 32)
+uint32_t ESmart3::rangeMask( size_t start, size_t end ) {
+    if( start >= end || end > 32 ) {
+        return 0;
+    }
+    uint32_t below_end = (end == 32) ? 0xffffffff : (1ul << end) - 1;
+    return below_end & ~((1ul << start) - 1);
+}
+
 // Prepare set commands that use offsets with range [start, end[
 //   cmd: byte buffer with enough room for all data, i.e. (end - start) * 2 + 2
 //   data: data to send (without offset)
-void ESmart3::initSetOffset( uint8_t *cmd, uint8_t *data, size_t start, size_t end ) {
+void ESmart3::initSetOffset( uint8_t *cmd, const uint8_t *data, size_t start, size_t end ) {
     cmd[0] = start;  // offset of data in item we are interested in (in 2-byte steps)
     cmd[1] = 0;
     memcpy(&cmd[2], data, (end - start) * 2);  // length of data in bytes
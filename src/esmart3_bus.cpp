@@ -0,0 +1,135 @@
+#include <esmart3_bus.h>
+
+#if defined(ESP32)
+
+#include <esp_timer.h>
+#include <string.h>
+
+ESmart3Bus::ESmart3Bus( ESmart3 &esmart3, size_t queue_len )
+    : _esmart3(esmart3), _queue_len(queue_len), _work(0), _task(0), _executed(0), _rejected(0) {
+    memset(_queue, 0, sizeof(_queue));
+    memset(_latency, 0, sizeof(_latency));
+}
+
+bool ESmart3Bus::begin( BaseType_t core, UBaseType_t priority, uint32_t stack_size ) {
+    if( _task ) {
+        return true;
+    }
+    for( size_t prio = 0; prio < PRIORITIES; prio++ ) {
+        if( !_queue[prio] ) {
+            _queue[prio] = xQueueCreate(_queue_len, sizeof(request_t));
+            if( !_queue[prio] ) {
+                return false;
+            }
+        }
+    }
+    if( !_work ) {
+        _work = xSemaphoreCreateCounting(_queue_len * PRIORITIES, 0);
+        if( !_work ) {
+            return false;
+        }
+    }
+    return xTaskCreatePinnedToCore(task, "esmart3", stack_size, this, priority, &_task, core) == pdPASS;
+}
+
+bool ESmart3Bus::submit( job_t job, void *arg, done_t done, TickType_t wait, priority_t prio ) {
+    if( !job ) {
+        return false;
+    }
+    if( !_task ) {
+        bool rc = job(_esmart3, arg);
+        if( done ) {
+            done(rc, arg);
+        }
+        return true;
+    }
+    request_t req = { job, arg, done, 0, 0, 0 };
+    return enqueue(req, wait, prio);
+}
+
+bool ESmart3Bus::call( job_t job, void *arg, TickType_t wait, priority_t prio ) {
+    if( !job ) {
+        return false;
+    }
+    if( !_task || xTaskGetCurrentTaskHandle() == _task ) {
+        return job(_esmart3, arg);  // not started yet or nested call from a job
+    }
+
+    // Semaphore lives on the callers stack: wait for job completion without timeout
+    bool rc = false;
+    StaticSemaphore_t buffer;
+    request_t req = { job, arg, 0, xSemaphoreCreateBinaryStatic(&buffer), &rc, 0 };
+    if( !enqueue(req, wait, prio) ) {
+        vSemaphoreDelete(req.sem);
+        return false;
+    }
+    xSemaphoreTake(req.sem, portMAX_DELAY);
+    vSemaphoreDelete(req.sem);
+    return rc;
+}
+
+size_t ESmart3Bus::pending() const {
+    size_t count = 0;
+    for( size_t prio = 0; prio < PRIORITIES; prio++ ) {
+        count += _queue[prio] ? uxQueueMessagesWaiting(_queue[prio]) : 0;
+    }
+    return count;
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+bool ESmart3Bus::enqueue( request_t &req, TickType_t wait, priority_t prio ) {
+    if( prio >= PRIORITIES ) {
+        prio = NORMAL;
+    }
+    req.queued = esp_timer_get_time();
+    if( xQueueSend(_queue[prio], &req, wait) != pdTRUE ) {
+        _rejected++;
+        return false;
+    }
+    xSemaphoreGive(_work);
+    return true;
+}
+
+void ESmart3Bus::task( void *self ) {
+    ((ESmart3Bus *)self)->run();
+}
+
+void ESmart3Bus::run() {
+    request_t req;
+    for(;;) {
+        if( xSemaphoreTake(_work, portMAX_DELAY) != pdTRUE ) {
+            continue;
+        }
+        // One job per semaphore count, highest priority first
+        int prio = PRIORITIES - 1;
+        while( prio >= 0 && xQueueReceive(_queue[prio], &req, 0) != pdTRUE ) {
+            prio--;
+        }
+        if( prio < 0 ) {
+            continue;
+        }
+        bool rc = req.job(_esmart3, req.arg);
+        _executed++;
+
+        latency_t &latency = _latency[prio];
+        latency.last = (uint32_t)(esp_timer_get_time() - req.queued);
+        if( latency.last > latency.max ) {
+            latency.max = latency.last;
+        }
+        latency.count++;
+
+        if( req.rc ) {
+            *req.rc = rc;
+        }
+        if( req.sem ) {
+            xSemaphoreGive(req.sem);
+        }
+        else if( req.done ) {
+            req.done(rc, req.arg);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include <esmart3_cache.h>
+
+#include <string.h>
+
+
+ESmart3Cache::ESmart3Cache() {
+    clear();
+}
+
+void ESmart3Cache::clear() {
+    memset(&_state, 0, sizeof(_state));
+    _state.magic = STATE_MAGIC;
+    _state.size = sizeof(_state);
+    _state.check = fnv(&_state, offsetof(state_t, check));
+    _valid = false;
+}
+
+bool ESmart3Cache::update( const ESmart3::Information_t &data ) {
+    if( !(_state.items & (1 << ESmart3::Information))
+     || memcmp(data.wSerialID, _state.information.wSerialID, sizeof(data.wSerialID)) ) {
+        uint8_t commandDelay = _state.commandDelay;
+        clear();  // parameters of another device
+        _state.commandDelay = commandDelay;
+    }
+    _valid = true;
+    return store(ESmart3::Information, &_state.information, &data, sizeof(data));
+}
+
+bool ESmart3Cache::update( const ESmart3::BatParam_t &data ) {
+    return store(ESmart3::BatParam, &_state.batParam, &data, sizeof(data));
+}
+
+bool ESmart3Cache::update( const ESmart3::Parameters_t &data ) {
+    return store(ESmart3::Parameters, &_state.parameters, &data, sizeof(data));
+}
+
+bool ESmart3Cache::update( const ESmart3::LoadParam_t &data ) {
+    return store(ESmart3::LoadParam, &_state.loadParam, &data, sizeof(data));
+}
+
+bool ESmart3Cache::update( const ESmart3::ProParam_t &data ) {
+    return store(ESmart3::ProParam, &_state.proParam, &data, sizeof(data));
+}
+
+bool ESmart3Cache::setCommandDelay( uint8_t ms ) {
+    if( ms == _state.commandDelay ) {
+        return false;
+    }
+    _state.commandDelay = ms;
+    _state.check = fnv(&_state, offsetof(state_t, check));
+    return true;
+}
+
+bool ESmart3Cache::restore( const state_t &state ) {
+    if( state.magic != STATE_MAGIC || state.size != sizeof(state_t)
+     || state.check != fnv(&state, offsetof(state_t, check)) ) {
+        return false;
+    }
+    _state = state;
+    _valid = false;  // until validate() or update(Information)
+    return true;
+}
+
+bool ESmart3Cache::validate( ESmart3 &esmart3 ) {
+    if( _valid ) {
+        return true;
+    }
+    if( !(_state.items & (1 << ESmart3::Information)) ) {
+        return false;
+    }
+    if( _state.commandDelay ) {
+        esmart3.setCommandDelay(_state.commandDelay);
+    }
+
+    // wSerial are words [1, 5[ of Information
+    ESmart3::Information_t data;
+    if( !esmart3.getInformation(data, 1, 5) ) {
+        return false;
+    }
+    if( memcmp(data.wSerial, _state.information.wSerial, sizeof(data.wSerial)) ) {
+        clear();
+        return false;
+    }
+    _valid = true;
+    return true;
+}
+
+bool ESmart3Cache::has( ESmart3::item_t item ) const {
+    return _valid && (_state.items & (1 << item));
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+// Copy data into cache if it differs. Return true if cache changed
+bool ESmart3Cache::store( ESmart3::item_t item, void *cached, const void *data, size_t size ) {
+    if( !_valid ) {
+        return false;  // device unknown: wait for update(Information) or validate()
+    }
+    if( (_state.items & (1 << item)) && memcmp(cached, data, size) == 0 ) {
+        return false;
+    }
+    memcpy(cached, data, size);
+    _state.items |= 1 << item;
+    _state.check = fnv(&_state, offsetof(state_t, check));
+    return true;
+}
+
+// Copy cached item into data if available for the connected device
+bool ESmart3Cache::copy( ESmart3::item_t item, void *data, const void *cached, size_t size ) const {
+    if( !has(item) ) {
+        return false;
+    }
+    memcpy(data, cached, size);
+    return true;
+}
+
+uint32_t ESmart3Cache::fnv( const void *data, size_t size ) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t hash = 2166136261u;
+    while( size-- ) {
+        hash ^= *(bytes++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,20 @@
+#include <esmart3_clock.h>
+
+
+ESmart3Clock::ESmart3Clock() : _valid(false), _epoch_ms(0), _sync_ms(0) {
+}
+
+int32_t ESmart3Clock::sync( uint64_t epoch_ms, uint32_t now_ms ) {
+    int32_t step = _valid ? (int32_t)(epoch_ms - epochMs(now_ms)) : 0;
+    _epoch_ms = epoch_ms;
+    _sync_ms = now_ms;
+    _valid = true;
+    return step;
+}
+
+uint64_t ESmart3Clock::epochMs( uint32_t ms ) const {
+    if( !_valid ) {
+        return 0;
+    }
+    return _epoch_ms + (int32_t)(ms - _sync_ms);  // signed: samples may be older than the sync
+}
@@ -0,0 +1,41 @@
+#include <esmart3_energy.h>
+
+#include <string.h>
+
+
+ESmart3Energy::ESmart3Energy( uint32_t max_gap_ms ) : _max_gap(max_gap_ms), _valid(false), _prev_ms(0) {
+    memset(&_prev, 0, sizeof(_prev));
+    reset();
+}
+
+void ESmart3Energy::reset() {
+    memset(&_state, 0, sizeof(_state));
+    _state.magic = STATE_MAGIC;
+}
+
+bool ESmart3Energy::restore( const state_t &state ) {
+    if( state.magic != STATE_MAGIC ) {
+        return false;
+    }
+    _state = state;
+    return true;
+}
+
+void ESmart3Energy::update( const ESmart3::ChgSts_t &data, uint32_t now_ms ) {
+    if( _valid ) {
+        uint32_t dt = now_ms - _prev_ms;
+        if( dt > _max_gap ) {
+            _state.gaps++;
+        }
+        else {
+            _state.chgPower += (uint64_t)(_prev.wChgPower + data.wChgPower) * dt;
+            _state.loadPower += (uint64_t)(_prev.wLoadPower + data.wLoadPower) * dt;
+            _state.chgCurr += (uint64_t)(_prev.wChgCurr + data.wChgCurr) * dt;
+            _state.loadCurr += (uint64_t)(_prev.wLoadCurr + data.wLoadCurr) * dt;
+            _state.time += dt;
+        }
+    }
+    _prev = data;
+    _prev_ms = now_ms;
+    _valid = true;
+}
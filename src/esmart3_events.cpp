@@ -0,0 +1,75 @@
+#include <esmart3_events.h>
+
+#include <string.h>
+
+
+static const char *faultNames[16] = {
+    "BatteryVoltageOver", "PvVoltageOver", "ChargeCurrentOver", "DischargeCurrentOver",
+    "BatteryTemperatureAlarm", "InternalTemperatureAlarm", "PvVoltageLow", "BatteryVoltageLow",
+    "TripZeroProtectionTrigger", "ControlByManualSwitchgear"
+};
+
+
+ESmart3Events::ESmart3Events( uint8_t debounce ) 
+    : _debounce(debounce ? debounce : 1), _valid(false), _next(0) {
+    memset(_state, 0, sizeof(_state));
+    memset(_count, 0, sizeof(_count));
+    memset(_log, 0, sizeof(_log));
+}
+
+size_t ESmart3Events::update( const ESmart3::ChgSts_t &data, uint32_t time ) {
+    uint16_t raw[2] = { data.wFault, data.wSystemReminder };
+    uint32_t first = _next;
+
+    for( size_t src = FAULT; src <= REMINDER; src++ ) {
+        if( !_valid ) {
+            _state[src] = raw[src];
+            for( uint8_t bit = 0; bit < 16; bit++ ) {
+                if( raw[src] & (1 << bit) ) {
+                    add((source_t)src, bit, true, time);
+                }
+            }
+            continue;
+        }
+
+        uint16_t diff = raw[src] ^ _state[src];
+        for( uint8_t bit = 0; bit < 16; bit++ ) {
+            uint8_t &count = _count[src][bit];
+            if( !(diff & (1 << bit)) ) {
+                count = 0;  // glitch is over
+            }
+            else if( ++count >= _debounce ) {
+                count = 0;
+                _state[src] ^= (1 << bit);
+                add((source_t)src, bit, raw[src] & (1 << bit), time);
+            }
+        }
+    }
+    _valid = true;
+
+    return _next - first;
+}
+
+bool ESmart3Events::event( uint32_t n, event_t &e ) const {
+    if( n >= _next || _next - n > LOG_SIZE ) {
+        return false;
+    }
+    e = _log[n % LOG_SIZE];
+    return true;
+}
+
+const char *ESmart3Events::name( source_t source, uint8_t bit ) {
+    return (source == FAULT && bit < 16) ? faultNames[bit] : 0;
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+void ESmart3Events::add( source_t source, uint8_t bit, bool raised, uint32_t time ) {
+    event_t &e = _log[_next % LOG_SIZE];
+    e.time = time;
+    e.source = source;
+    e.bit = bit;
+    e.raised = raised;
+    _next++;
+}
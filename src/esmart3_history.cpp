@@ -0,0 +1,216 @@
+#include <esmart3_history.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+
+// ChgSts fields PvVolt to BatCap
+static const size_t FIRST_FIELD = 1;
+
+static const uint32_t periods[ESmart3History::RESOLUTIONS] = { 0, 60, 15 * 60, 60 * 60 };
+static const char *names[ESmart3History::RESOLUTIONS] = { "raw", "1m", "15m", "1h" };
+
+
+ESmart3History::ESmart3History( size_t raw, size_t min1, size_t min15, size_t hour1 )
+    : _raw(0), _rawSize(raw), _rawNewest(0), _rawUsed(0) {
+    size_t sizes[] = { min1, min15, hour1 };
+    for( size_t i = 0; i < RESOLUTIONS - 1; i++ ) {
+        memset(&_tier[i], 0, sizeof(_tier[i]));
+        _tier[i].size = sizes[i];
+    }
+}
+
+ESmart3History::~ESmart3History() {
+    free(_raw);
+    for( size_t i = 0; i < RESOLUTIONS - 1; i++ ) {
+        free(_tier[i].slots);
+    }
+}
+
+bool ESmart3History::begin( bool psram ) {
+    if( !_raw && _rawSize ) {
+        _raw = (sample_t *)alloc(_rawSize * sizeof(sample_t), psram);
+    }
+    bool rc = _raw || !_rawSize;
+    for( size_t i = 0; i < RESOLUTIONS - 1; i++ ) {
+        tier_t &tier = _tier[i];
+        if( !tier.slots && tier.size ) {
+            tier.slots = (slot_t *)alloc(tier.size * sizeof(slot_t), psram);
+        }
+        if( !tier.slots ) {
+            tier.size = 0;  // disable tier
+            rc = false;
+        }
+    }
+    if( !_raw ) {
+        _rawSize = 0;
+    }
+    return rc;
+}
+
+void ESmart3History::add( const ESmart3::ChgSts_t &data, uint32_t time ) {
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    int16_t value[FIELDS];
+    for( size_t i = 0; i < FIELDS; i++ ) {
+        value[i] = (int16_t)ESmart3::value(&data, fields[FIRST_FIELD + i]);
+    }
+
+    if( _rawSize ) {
+        if( !_rawUsed || time >= _raw[_rawNewest].time ) {
+            if( _rawUsed ) {
+                _rawNewest = (_rawNewest + 1) % _rawSize;
+            }
+            if( _rawUsed < _rawSize ) {
+                _rawUsed++;
+            }
+            _raw[_rawNewest].time = time;
+            memcpy(_raw[_rawNewest].value, value, sizeof(value));
+        }
+    }
+
+    for( size_t i = 0; i < RESOLUTIONS - 1; i++ ) {
+        addTier(_tier[i], periods[i + 1], value, time);
+    }
+}
+
+size_t ESmart3History::query( resolution_t res, uint32_t from, uint32_t to, visit_t visit, void *arg ) const {
+    record_t record;
+    size_t visited = 0;
+
+    if( res == RAW ) {
+        record.count = 1;
+        for( size_t n = _rawUsed; n > 0; n-- ) {
+            const sample_t &sample = _raw[(_rawNewest + _rawSize - n + 1) % _rawSize];
+            if( sample.time >= from && sample.time < to ) {
+                record.time = sample.time;
+                memcpy(record.min, sample.value, sizeof(sample.value));
+                memcpy(record.max, sample.value, sizeof(sample.value));
+                memcpy(record.avg, sample.value, sizeof(sample.value));
+                visit(record, arg);
+                visited++;
+            }
+        }
+    }
+    else if( res < RESOLUTIONS ) {
+        const tier_t &tier = _tier[res - 1];
+        uint32_t per = periods[res];
+        for( size_t n = tier.used; n > 0; n-- ) {
+            const slot_t &slot = tier.slots[(tier.newest + tier.size - n + 1) % tier.size];
+            uint32_t time = tier.time - (n - 1) * per;
+            if( slot.count && time >= from && time < to ) {
+                record.time = time;
+                record.count = slot.count;
+                memcpy(record.min, slot.min, sizeof(slot.min));
+                memcpy(record.max, slot.max, sizeof(slot.max));
+                memcpy(record.avg, slot.avg, sizeof(slot.avg));
+                visit(record, arg);
+                visited++;
+            }
+        }
+    }
+
+    return visited;
+}
+
+uint32_t ESmart3History::period( resolution_t res ) {
+    return res < RESOLUTIONS ? periods[res] : 0;
+}
+
+const char *ESmart3History::name( resolution_t res ) {
+    return res < RESOLUTIONS ? names[res] : "";
+}
+
+ESmart3History::resolution_t ESmart3History::resolution( const char *name ) {
+    for( size_t i = 0; i < RESOLUTIONS; i++ ) {
+        if( strcmp(name, names[i]) == 0 ) {
+            return (resolution_t)i;
+        }
+    }
+    return RESOLUTIONS;
+}
+
+const char *ESmart3History::fieldName( size_t index ) {
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    return index < FIELDS ? fields[FIRST_FIELD + index].name : "";
+}
+
+size_t ESmart3History::memory() const {
+    size_t size = _rawSize * sizeof(sample_t);
+    for( size_t i = 0; i < RESOLUTIONS - 1; i++ ) {
+        size += _tier[i].size * sizeof(slot_t);
+    }
+    return size;
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+void *ESmart3History::alloc( size_t size, bool psram ) {
+#if defined(ESP32)
+    if( psram ) {
+        void *mem = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if( mem ) {
+            return mem;
+        }
+    }
+#endif
+    return malloc(size);
+}
+
+// Add value to the slot of the period containing time. Skipped periods get empty slots
+void ESmart3History::addTier( tier_t &tier, uint32_t period, const int16_t *value, uint32_t time ) {
+    if( !tier.size ) {
+        return;
+    }
+
+    uint32_t start = time - time % period;
+    if( !tier.used ) {
+        tier.newest = 0;
+        tier.used = 1;
+        tier.time = start;
+        tier.slots[0].count = 0;
+    }
+    else if( start > tier.time ) {
+        uint32_t steps = (start - tier.time) / period;
+        if( steps > tier.size ) {
+            steps = tier.size;  // all slots are outdated
+        }
+        while( steps-- ) {
+            tier.newest = (tier.newest + 1) % tier.size;
+            tier.slots[tier.newest].count = 0;
+            if( tier.used < tier.size ) {
+                tier.used++;
+            }
+        }
+        tier.time = start;
+    }
+    else if( start < tier.time ) {
+        return;  // older than newest slot
+    }
+
+    slot_t &slot = tier.slots[tier.newest];
+    if( !slot.count ) {
+        memcpy(slot.min, value, sizeof(slot.min));
+        memcpy(slot.max, value, sizeof(slot.max));
+        memset(tier.sum, 0, sizeof(tier.sum));
+    }
+    if( slot.count < 0xffff ) {
+        slot.count++;
+        for( size_t i = 0; i < FIELDS; i++ ) {
+            if( value[i] < slot.min[i] ) {
+                slot.min[i] = value[i];
+            }
+            if( value[i] > slot.max[i] ) {
+                slot.max[i] = value[i];
+            }
+            tier.sum[i] += value[i];
+            slot.avg[i] = tier.sum[i] / slot.count;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#include <esmart3_profile.h>
+
+#include <string.h>
+
+
+ESmart3Profile::ESmart3Profile( ESmart3 &esmart3 )
+    : _esmart3(esmart3), _next(0), _prev(0), _ok(true), _checks(0), _drifts(0), _writes(0), _errors(0) {
+    memset(&_batParam, 0, sizeof(_batParam));
+    memset(&_proParam, 0, sizeof(_proParam));
+    memset(&_loadParam, 0, sizeof(_loadParam));
+    memset(_mask, 0, sizeof(_mask));
+}
+
+void ESmart3Profile::setBatParam( const ESmart3::BatParam_t &data, uint32_t mask ) {
+    _batParam = data;
+    _mask[BAT] = mask;
+}
+
+void ESmart3Profile::setProParam( const ESmart3::ProParam_t &data, uint32_t mask ) {
+    _proParam = data;
+    _mask[PRO] = mask;
+}
+
+void ESmart3Profile::setLoadParam( const ESmart3::LoadParam_t &data, uint32_t mask ) {
+    _loadParam = data;
+    _mask[LOAD] = mask;
+}
+
+bool ESmart3Profile::handle( uint32_t interval_ms ) {
+    size_t items = 0;
+    for( size_t i = 0; i < ITEMS; i++ ) {
+        if( _mask[i] ) {
+            items++;
+        }
+    }
+    if( !items ) {
+        return true;
+    }
+
+    // spread checks evenly so the bus is never busy with more than one short frame at a time
+    uint32_t now = millis();
+    if( now - _prev >= interval_ms / items ) {
+        _prev = now;
+        _ok = check();
+    }
+    return _ok;
+}
+
+bool ESmart3Profile::check() {
+    for( size_t tries = 0; tries < ITEMS; tries++ ) {
+        size_t item = _next;
+        _next = (_next + 1) % ITEMS;
+        if( !_mask[item] ) {
+            continue;
+        }
+
+        size_t frames = 0;
+        bool rc = false;
+        switch( item ) {
+            case BAT:
+                rc = _esmart3.update(ESmart3::BatParam, (const uint16_t *)&_batParam, _mask[item], &frames);
+                break;
+            case PRO:
+                rc = _esmart3.update(ESmart3::ProParam, (const uint16_t *)&_proParam, _mask[item], &frames);
+                break;
+            case LOAD:
+                rc = _esmart3.update(ESmart3::LoadParam, (const uint16_t *)&_loadParam, _mask[item], &frames);
+                break;
+        }
+
+        _checks++;
+        if( frames ) {
+            _drifts++;
+            _writes += frames;
+        }
+        if( !rc ) {
+            _errors++;
+        }
+        return rc;
+    }
+    return true;  // nothing to enforce
+}
@@ -0,0 +1,116 @@
+#include <esmart3_soc.h>
+
+#include <string.h>
+
+
+// Charge unit of state is 2 * dA * ms, so 1 mAh is 2 * 3600000 / 100
+static const uint64_t MAH = 2 * 3600 * 1000 / 100;
+
+
+ESmart3Soc::config_t ESmart3Soc::defaults() {
+    config_t config;
+    config.capacityMAh = 100000;
+    config.efficiency = 990;
+    config.fullVolt = 138;
+    config.fullCurr = 20;
+    config.emptyVolt = 120;
+    config.settleMs = 60000;
+    config.maxGapMs = 5000;
+    return config;
+}
+
+ESmart3Soc::ESmart3Soc( const config_t &config ) : _config(config) {
+    memset(&_prev, 0, sizeof(_prev));
+    reset();
+}
+
+void ESmart3Soc::reset() {
+    memset(&_state, 0, sizeof(_state));
+    _state.magic = STATE_MAGIC;
+    _state.capacity = _config.capacityMAh * MAH;
+    _state.charge = -1;  // not yet known
+    _valid = false;
+    memset(&_full, 0, sizeof(_full));
+    memset(&_empty, 0, sizeof(_empty));
+}
+
+bool ESmart3Soc::restore( const state_t &state ) {
+    if( state.magic != STATE_MAGIC || state.capacity != _config.capacityMAh * MAH ) {
+        return false;
+    }
+    _state = state;
+    return true;
+}
+
+void ESmart3Soc::update( const ESmart3::ChgSts_t &data, uint32_t now_ms ) {
+    int64_t capacity = (int64_t)_state.capacity;
+
+    if( _state.charge < 0 ) {
+        _state.charge = capacity * (data.wBatCap > 100 ? 100 : data.wBatCap) / 100;
+    }
+    else if( _valid ) {
+        uint32_t dt = now_ms - _prev_ms;
+        if( dt <= _config.maxGapMs ) {
+            int64_t delta = ((int64_t)_prev.wChgCurr - _prev.wLoadCurr + data.wChgCurr - data.wLoadCurr) * dt;
+            if( delta > 0 ) {
+                delta = delta * _config.efficiency / 1000;
+            }
+            _state.charge += delta;
+            if( _state.charge > capacity ) {
+                _state.charge = capacity;
+            }
+            else if( _state.charge < 0 ) {
+                _state.charge = 0;
+            }
+        }
+    }
+
+    bool full = (data.wBatVolt >= _config.fullVolt || data.wChgMode == ESmart3::CHG_FLOAT)
+        && data.wChgCurr <= _config.fullCurr;
+    if( settled(full, _full, now_ms) ) {
+        _state.charge = capacity;
+        _state.calibrations++;
+    }
+    if( settled(data.wBatVolt <= _config.emptyVolt, _empty, now_ms) ) {
+        _state.charge = 0;
+        _state.calibrations++;
+    }
+
+    _prev = data;
+    _prev_ms = now_ms;
+    _valid = true;
+}
+
+float ESmart3Soc::soc() const {
+    return _state.charge > 0 && _state.capacity ? 100.0f * _state.charge / _state.capacity : 0;
+}
+
+uint16_t ESmart3Soc::permille() const {
+    return _state.charge > 0 && _state.capacity ? _state.charge * 1000 / _state.capacity : 0;
+}
+
+uint32_t ESmart3Soc::chargeMAh() const {
+    return _state.charge > 0 ? _state.charge / MAH : 0;
+}
+
+
+// Private Stuff (used internally, not by library user)
+
+// Return true once if condition held for settleMs. Condition must be left before it triggers again
+bool ESmart3Soc::settled( bool condition, condition_t &state, uint32_t now_ms ) {
+    if( !condition ) {
+        state.met = false;
+        state.done = false;
+        return false;
+    }
+    if( !state.met ) {
+        state.met = true;
+        state.since = now_ms;
+        return false;
+    }
+    if( !state.done && now_ms - state.since >= _config.settleMs ) {
+        state.done = true;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#include <esmart3_stats.h>
+
+#include <math.h>
+#include <string.h>
+
+
+ESmart3Stats::ESmart3Stats( uint32_t ema1_s, uint32_t ema2_s ) : _valid(false), _prev_ms(0) {
+    _window[0] = ema1_s * 1000;
+    _window[1] = ema2_s * 1000;
+    memset(_stat, 0, sizeof(_stat));
+}
+
+void ESmart3Stats::reset() {
+    for( size_t i = 0; i < FIELDS; i++ ) {
+        stat_t &s = _stat[i];
+        s.count = 0;
+        s.mean = 0;
+        s.m2 = 0;
+    }
+}
+
+void ESmart3Stats::add( const ESmart3::ChgSts_t &data, uint32_t time, uint32_t now_ms ) {
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+
+    // weight of new sample per moving average: dt / (window + dt)
+    float alpha[EMAS];
+    for( size_t e = 0; e < EMAS; e++ ) {
+        uint32_t dt = _valid ? now_ms - _prev_ms : 0;
+        alpha[e] = (_valid && _window[e]) ? (float)dt / (_window[e] + dt) : 1;
+    }
+
+    for( size_t i = 0; i < FIELDS && i < count; i++ ) {
+        int32_t value = ESmart3::value(&data, fields[i]);
+        stat_t &s = _stat[i];
+
+        if( s.count == 0 || value < s.min ) {
+            s.min = value;
+            s.minTime = time;
+        }
+        if( s.count == 0 || value > s.max ) {
+            s.max = value;
+            s.maxTime = time;
+        }
+
+        s.count++;
+        double delta = value - s.mean;
+        s.mean += delta / s.count;
+        s.m2 += delta * (value - s.mean);
+
+        for( size_t e = 0; e < EMAS; e++ ) {
+            s.ema[e] += alpha[e] * (value - s.ema[e]);
+        }
+    }
+
+    _prev_ms = now_ms;
+    _valid = true;
+}
+
+double ESmart3Stats::variance( size_t index ) const {
+    const stat_t &s = _stat[index];
+    return s.count > 1 ? s.m2 / (s.count - 1) : 0;
+}
+
+double ESmart3Stats::stddev( size_t index ) const {
+    return sqrt(variance(index));
+}
+
+const char *ESmart3Stats::fieldName( size_t index ) {
+    size_t count;
+    const ESmart3::field_t *fields = ESmart3::fields(ESmart3::ChgSts, count);
+    return index < count ? fields[index].name : "";
+}